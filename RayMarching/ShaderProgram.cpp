@@ -1,5 +1,7 @@
 #include "ShaderProgram.h"
 
+#include <vector>
+
 ShaderProgram::ShaderProgram(const std::unordered_map<GLenum, std::string> &inputShaders) {
 
     shaderProgram = glCreateProgram();
@@ -42,8 +44,11 @@ ShaderProgram::ShaderProgram(const std::unordered_map<GLenum, std::string> &inpu
         glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
         std::cerr << "Shader program linking failed\n" << infoLog << std::endl;
         shaderProgram = 0;
+        return;
     }
 
+    CacheUniforms();
+
 }
 
 void ShaderProgram::Release() {
@@ -99,9 +104,50 @@ bool ShaderProgram::reLink() {
         return false;
     }
 
+    CacheUniforms();
     return true;
 }
 
+void ShaderProgram::CacheUniforms() {
+    uniformLocations.clear();
+
+    GLint numUniforms = 0;
+    GLint maxNameLength = 0;
+    glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORMS, &numUniforms);
+    glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    std::vector<GLchar> nameBuffer(maxNameLength + 1);
+    for (GLint i = 0; i < numUniforms; i++) {
+        GLsizei nameLength;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(shaderProgram, GLuint(i), GLsizei(nameBuffer.size()), &nameLength, &size, &type, nameBuffer.data());
+
+        const std::string name(nameBuffer.data(), nameLength);
+        const GLint location = glGetUniformLocation(shaderProgram, name.c_str());
+        if (location == -1) {
+            continue; // member of a uniform block
+        }
+
+        uniformLocations[name] = location;
+
+        // Arrays are reported as "name[0]", make plain "name" resolve too
+        const auto bracket = name.find('[');
+        if (bracket != std::string::npos) {
+            uniformLocations[name.substr(0, bracket)] = location;
+        }
+    }
+}
+
+Uniform ShaderProgram::GetUniform(const std::string &name) const {
+    const auto it = uniformLocations.find(name);
+    if (it == uniformLocations.end()) {
+        std::cerr << "Uniform  " << name << " not found" << std::endl;
+        return Uniform();
+    }
+    return Uniform(it->second);
+}
+
 GLuint ShaderProgram::LoadShaderObject(GLenum type, const std::string &filename) {
     std::ifstream fs(filename);
 
@@ -141,47 +187,42 @@ void ShaderProgram::StopUseShader() const {
 }
 
 void ShaderProgram::SetUniform(const std::string &location, int value) const {
-    GLint uniformLocation = glGetUniformLocation(shaderProgram, location.c_str());
-    if (uniformLocation == -1) {
-        std::cerr << "Uniform  " << location << " not found" << std::endl;
-        return;
-    }
-    glUniform1i(uniformLocation, value);
+    SetUniform(GetUniform(location), value);
 }
 
 void ShaderProgram::SetUniform(const std::string &location, unsigned int value) const {
-    GLint uniformLocation = glGetUniformLocation(shaderProgram, location.c_str());
-    if (uniformLocation == -1) {
-        std::cerr << "Uniform  " << location << " not found" << std::endl;
-        return;
-    }
-    glUniform1ui(uniformLocation, value);
+    SetUniform(GetUniform(location), value);
 }
 
 void ShaderProgram::SetUniform(const std::string &location, float value) const {
-    GLint uniformLocation = glGetUniformLocation(shaderProgram, location.c_str());
-    if (uniformLocation == -1) {
-        std::cerr << "Uniform  " << location << " not found" << std::endl;
-        return;
-    }
-    glUniform1f(uniformLocation, value);
+    SetUniform(GetUniform(location), value);
 }
 
 void ShaderProgram::SetUniform(const std::string &location, LiteMath::float4x4 a_mat) const {
-    GLint uniformLocation = glGetUniformLocation(shaderProgram, location.c_str());
-    if (uniformLocation == -1) {
-        std::cerr << "Uniform  " << location << " not found" << std::endl;
-        return;
-    }
-
-    glUniformMatrix4fv(uniformLocation, 1, true, a_mat.L());
+    SetUniform(GetUniform(location), a_mat);
 }
 
 void ShaderProgram::SetUniform(const std::string &location, double value) const {
-    GLint uniformLocation = glGetUniformLocation(shaderProgram, location.c_str());
-    if (uniformLocation == -1) {
-        std::cerr << "Uniform  " << location << " not found" << std::endl;
-        return;
-    }
-    glUniform1d(uniformLocation, value);
+    SetUniform(GetUniform(location), value);
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, int value) const {
+    // Location -1 is silently ignored by GL, same as a missing uniform
+    glUniform1i(uniform.location, value);
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, unsigned int value) const {
+    glUniform1ui(uniform.location, value);
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, float value) const {
+    glUniform1f(uniform.location, value);
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, LiteMath::float4x4 a_mat) const {
+    glUniformMatrix4fv(uniform.location, 1, true, a_mat.L());
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, double value) const {
+    glUniform1d(uniform.location, value);
 }
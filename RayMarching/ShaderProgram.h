@@ -6,6 +6,15 @@
 
 #include "LiteMath.h"
 
+// Uniform location resolved once at link time
+struct Uniform {
+    GLint location;
+
+    Uniform() : location(-1) {}
+
+    explicit Uniform(GLint location) : location(location) {}
+};
+
 class ShaderProgram {
 public:
 
@@ -25,6 +34,9 @@ public:
 
     bool reLink();
 
+    // Lookup in the table filled at link time, no GL calls involved
+    Uniform GetUniform(const std::string &name) const;
+
     void SetUniform(const std::string &location, float value) const;
 
     void SetUniform(const std::string &location, double value) const;
@@ -35,11 +47,24 @@ public:
 
     void SetUniform(const std::string &location, LiteMath::float4x4) const;
 
+    void SetUniform(Uniform uniform, float value) const;
+
+    void SetUniform(Uniform uniform, double value) const;
+
+    void SetUniform(Uniform uniform, int value) const;
+
+    void SetUniform(Uniform uniform, unsigned int value) const;
+
+    void SetUniform(Uniform uniform, LiteMath::float4x4) const;
+
 private:
     static GLuint LoadShaderObject(GLenum type, const std::string &filename);
 
+    void CacheUniforms();
+
     GLuint shaderProgram;
     std::unordered_map<GLenum, GLuint> shaderObjects;
+    std::unordered_map<std::string, GLint> uniformLocations;
 };
 
 #endif
\ No newline at end of file
@@ -283,6 +283,16 @@ int main(int argc, char **argv) {
     ShaderProgram program(shaders);
     GL_CHECK_ERRORS;
 
+    const auto u_rayMatrix = program.GetUniform("g_rayMatrix");
+    const auto u_screenWidth = program.GetUniform("g_screenWidth");
+    const auto u_screenHeight = program.GetUniform("g_screenHeight");
+    const auto u_time = program.GetUniform("g_time");
+    const auto u_softShadows = program.GetUniform("g_softShadows");
+    const auto u_reflect = program.GetUniform("g_reflect");
+    const auto u_refract = program.GetUniform("g_refract");
+    const auto u_ambient = program.GetUniform("g_ambient");
+    const auto u_antiAlias = program.GetUniform("g_antiAlias");
+
     glfwSwapInterval(1); // force 60 frames per second
 
     GLuint g_vertexBufferObject;
@@ -360,21 +370,21 @@ int main(int argc, char **argv) {
         g_rayMatrix = mul(g_rayMatrix, rotate_Z_4x4(rot_step));
         g_camPos += mul(g_rayMatrix, multiplier * step);
 
-        program.SetUniform("g_rayMatrix", mul(translate4x4(g_camPos), g_rayMatrix));
+        program.SetUniform(u_rayMatrix, mul(translate4x4(g_camPos), g_rayMatrix));
 
-        program.SetUniform("g_screenWidth", WIDTH);
-        program.SetUniform("g_screenHeight", HEIGHT);
+        program.SetUniform(u_screenWidth, WIDTH);
+        program.SetUniform(u_screenHeight, HEIGHT);
 
-        program.SetUniform("g_time", g_time);
+        program.SetUniform(u_time, g_time);
         if (inc_time) {
             g_time++;
         }
 
-        program.SetUniform("g_softShadows", g_softShadows);
-        program.SetUniform("g_reflect", g_reflect);
-        program.SetUniform("g_refract", g_refract);
-        program.SetUniform("g_ambient", g_ambient);
-        program.SetUniform("g_antiAlias", g_antiAlias);
+        program.SetUniform(u_softShadows, g_softShadows);
+        program.SetUniform(u_reflect, g_reflect);
+        program.SetUniform(u_refract, g_refract);
+        program.SetUniform(u_ambient, g_ambient);
+        program.SetUniform(u_antiAlias, g_antiAlias);
 
         glBindTexture(GL_TEXTURE_CUBE_MAP, skybox);
 
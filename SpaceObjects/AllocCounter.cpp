@@ -0,0 +1,43 @@
+#include "AllocCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<size_t> total_allocations(0);
+std::atomic<size_t> total_bytes(0);
+
+void* counted_alloc(size_t size) {
+    total_allocations.fetch_add(1, std::memory_order_relaxed);
+    total_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+} // namespace
+
+AllocCounter AllocCounter::snapshot() {
+    return {total_allocations.load(std::memory_order_relaxed), total_bytes.load(std::memory_order_relaxed)};
+}
+
+void* operator new(size_t size) {
+    return counted_alloc(size);
+}
+
+void* operator new[](size_t size) {
+    return counted_alloc(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
@@ -0,0 +1,25 @@
+#ifndef SPACEOBJECTS_ALLOCCOUNTER_H
+#define SPACEOBJECTS_ALLOCCOUNTER_H
+
+#include <cstddef>
+
+// Process-wide heap statistics, collected by the replaced global operator new.
+// Take a snapshot before and after a piece of code to see what it allocated
+struct AllocCounter {
+    size_t allocations;
+    size_t bytes;
+
+    static AllocCounter snapshot();
+
+    AllocCounter operator-(const AllocCounter& other) const {
+        return {allocations - other.allocations, bytes - other.bytes};
+    }
+
+    AllocCounter& operator+=(const AllocCounter& other) {
+        allocations += other.allocations;
+        bytes += other.bytes;
+        return *this;
+    }
+};
+
+#endif //SPACEOBJECTS_ALLOCCOUNTER_H
@@ -12,6 +12,22 @@ struct BBox {
 
     BBox(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
 
+    // Tight bounds of the box after an affine transform, rotation included
+    BBox transformed(const glm::mat4& transform) const {
+        const auto center = 0.5f * (min + max);
+        const auto extent = 0.5f * (max - min);
+
+        const glm::vec3 world_center = transform * glm::vec4(center, 1.0f);
+        glm::vec3 world_extent;
+        for (int i = 0; i < 3; i++) {
+            world_extent[i] = glm::abs(transform[0][i]) * extent.x
+                            + glm::abs(transform[1][i]) * extent.y
+                            + glm::abs(transform[2][i]) * extent.z;
+        }
+
+        return BBox(world_center - world_extent, world_center + world_extent);
+    }
+
     friend bool intersect(const BBox& first, const BBox& second) {
         return first.min.x <= second.max.x && first.max.x >= second.min.x
             && first.min.y <= second.max.y && first.max.y >= second.min.y
@@ -30,6 +46,35 @@ struct BBox {
 
         return tmax >= tmin;
     }
+
+    // Slab test that also reports the entry distance, hits behind the ray origin do not count
+    friend bool intersect(const BBox& bbox, const glm::vec3& ray_src, const glm::vec3& ray_dir_inverse, float& t) {
+        const auto dist1 = (bbox.min - ray_src) * ray_dir_inverse;
+        const auto dist2 = (bbox.max - ray_src) * ray_dir_inverse;
+
+        const auto dist_min = glm::min(dist1, dist2);
+        const auto dist_max = glm::max(dist1, dist2);
+
+        float tmin = glm::max(dist_min.x, dist_min.y, dist_min.z);
+        float tmax = glm::min(dist_max.x, dist_max.y, dist_max.z);
+
+        t = glm::max(tmin, 0.0f);
+        return tmax >= t;
+    }
+
+    BBox merged(const BBox& other) const {
+        return BBox(glm::min(min, other.min), glm::max(max, other.max));
+    }
+
+    bool contains(const BBox& other) const {
+        return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z
+            && max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+    }
+
+    float surfaceArea() const {
+        const auto d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
 };
 
 #endif //SPACEOBJECTS_BBOX_H
@@ -0,0 +1,76 @@
+#include "CacheFile.h"
+
+#include <sys/stat.h>
+
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#include <iterator>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool stat_source(const std::string& path, SourceStamp& stamp) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+
+    stamp.size = uint64_t(st.st_size);
+    stamp.mtime = int64_t(st.st_mtime);
+    return true;
+}
+
+uint64_t hash_source(const std::string& path) {
+    MappedFile file(path);
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    const auto data = reinterpret_cast<const unsigned char*>(file.data());
+    for (size_t i = 0; i < file.size(); i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::string temporary_path(const std::string& path) {
+#ifdef _WIN32
+    const auto pid = _getpid();
+#else
+    const auto pid = getpid();
+#endif
+    return path + "." + std::to_string(pid) + "-" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+}
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return;
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    begin = buffer.data();
+    length = buffer.size();
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* mapping = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            begin = static_cast<const char*>(mapping);
+            length = size_t(st.st_size);
+        }
+    }
+    close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (begin != nullptr) {
+        munmap(const_cast<char*>(begin), length);
+    }
+#endif
+}
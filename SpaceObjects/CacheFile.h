@@ -0,0 +1,98 @@
+#ifndef SPACEOBJECTS_CACHEFILE_H
+#define SPACEOBJECTS_CACHEFILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Building blocks of the on-disk caches kept next to imported assets
+
+struct SourceStamp {
+    uint64_t size;
+    int64_t mtime;
+};
+
+bool stat_source(const std::string& path, SourceStamp& stamp);
+
+// 64-bit FNV-1a of the whole file
+uint64_t hash_source(const std::string& path);
+
+// Name to write a cache under before renaming it to path, distinct for every process and thread,
+// so concurrent writers of the same cache never share a file
+std::string temporary_path(const std::string& path);
+
+// Read-only view of a whole file, mapped into memory where the platform allows it
+class MappedFile {
+    const char* begin = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    std::vector<char> buffer;
+#endif
+
+public:
+    explicit MappedFile(const std::string& path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return begin; }
+    size_t size() const { return length; }
+};
+
+// Bounds-checked cursor over a mapped cache
+struct Reader {
+    const char* cur;
+    const char* end;
+
+    template <typename T>
+    bool read(T& value) {
+        if (size_t(end - cur) < sizeof(T)) return false;
+        std::memcpy(&value, cur, sizeof(T));
+        cur += sizeof(T);
+        return true;
+    }
+
+    template <typename T>
+    bool read_array(std::vector<T>& values) {
+        uint32_t count;
+        if (!read(count) || size_t(end - cur) / sizeof(T) < count) return false;
+        values.resize(count);
+        std::memcpy(values.data(), cur, count * sizeof(T));
+        cur += count * sizeof(T);
+        return true;
+    }
+
+    bool read_string(std::string& value) {
+        uint32_t count;
+        if (!read(count) || size_t(end - cur) < count) return false;
+        value.assign(cur, count);
+        cur += count;
+        return true;
+    }
+};
+
+struct Writer {
+    std::ofstream& out;
+
+    template <typename T>
+    void write(const T& value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    void write_array(const std::vector<T>& values) {
+        write(uint32_t(values.size()));
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    void write_string(const std::string& value) {
+        write(uint32_t(value.size()));
+        out.write(value.data(), value.size());
+    }
+};
+
+#endif //SPACEOBJECTS_CACHEFILE_H
@@ -5,6 +5,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include "Frustum.h"
+
 enum class CameraMode {
     FIRST_PERSON,
     THIRD_PERSON,
@@ -40,6 +42,11 @@ struct Camera {
             return glm::lookAt(tmp_position - rot * direction, tmp_position, rot * up);
         }
     }
+
+    // Planes of the volume seen through the given projection, in world space
+    Frustum getFrustum(const glm::mat4& projection) const {
+        return Frustum(projection * getViewTransform());
+    }
 };
 
 #endif //SPACEOBJECTS_CAMERA_H
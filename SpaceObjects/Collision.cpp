@@ -0,0 +1,85 @@
+#include "Collision.h"
+
+#include <algorithm>
+
+void CollisionWorld::link(const Entry& entry) {
+    for (int x = entry.cell_min.x; x <= entry.cell_max.x; x++) {
+        for (int y = entry.cell_min.y; y <= entry.cell_max.y; y++) {
+            for (int z = entry.cell_min.z; z <= entry.cell_max.z; z++) {
+                cells[cellKey(x, y, z)].push_back(&entry);
+            }
+        }
+    }
+}
+
+void CollisionWorld::unlink(const Entry& entry) {
+    for (int x = entry.cell_min.x; x <= entry.cell_max.x; x++) {
+        for (int y = entry.cell_min.y; y <= entry.cell_max.y; y++) {
+            for (int z = entry.cell_min.z; z <= entry.cell_max.z; z++) {
+                const auto cell = cells.find(cellKey(x, y, z));
+                if (cell == cells.end()) continue;
+
+                auto& items = cell->second;
+                const auto it = std::find(items.begin(), items.end(), &entry);
+                if (it != items.end()) {
+                    *it = items.back();
+                    items.pop_back();
+                }
+                if (items.empty()) {
+                    cells.erase(cell);
+                }
+            }
+        }
+    }
+}
+
+void CollisionWorld::insert(Id id, unsigned layer, const BBox& box) {
+    remove(id);
+
+    auto& entry = entries[id];
+    entry.id = id;
+    entry.layer = layer;
+    entry.box = box;
+    entry.cell_min = cellOf(box.min);
+    entry.cell_max = cellOf(box.max);
+
+    if (layer >= layers.size()) {
+        layers.resize(layer + 1);
+    }
+    entry.layer_index = layers[layer].size();
+    layers[layer].push_back(&entry);
+
+    link(entry);
+}
+
+void CollisionWorld::update(Id id, const BBox& box) {
+    const auto it = entries.find(id);
+    if (it == entries.end()) return;
+
+    auto& entry = it->second;
+    entry.box = box;
+
+    const auto cell_min = cellOf(box.min);
+    const auto cell_max = cellOf(box.max);
+    if (cell_min == entry.cell_min && cell_max == entry.cell_max) return;
+
+    unlink(entry);
+    entry.cell_min = cell_min;
+    entry.cell_max = cell_max;
+    link(entry);
+}
+
+void CollisionWorld::remove(Id id) {
+    const auto it = entries.find(id);
+    if (it == entries.end()) return;
+
+    auto& entry = it->second;
+    unlink(entry);
+
+    auto& layer = layers[entry.layer];
+    layer[entry.layer_index] = layer.back();
+    layer[entry.layer_index]->layer_index = entry.layer_index;
+    layer.pop_back();
+
+    entries.erase(it);
+}
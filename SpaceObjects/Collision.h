@@ -0,0 +1,94 @@
+#ifndef SPACEOBJECTS_COLLISION_H
+#define SPACEOBJECTS_COLLISION_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "BBox.h"
+
+// Broad phase over world-space AABBs on a hashed uniform grid.
+// An entity is linked into every cell its box overlaps; moving it only touches
+// the grid when it crosses a cell boundary
+class CollisionWorld {
+public:
+    typedef uint32_t Id;
+
+private:
+    struct Entry {
+        Id id;
+        unsigned layer;
+        BBox box;
+        glm::ivec3 cell_min;
+        glm::ivec3 cell_max;
+        size_t layer_index; // position in layers[layer]
+    };
+
+    float cell_size;
+    std::unordered_map<Id, Entry> entries;
+    // Entries are never moved by the map, so cells and layers can point at them
+    std::unordered_map<uint64_t, std::vector<const Entry*>> cells;
+    std::vector<std::vector<Entry*>> layers;
+
+    glm::ivec3 cellOf(const glm::vec3& point) const {
+        return glm::ivec3(glm::floor(point / cell_size));
+    }
+
+    static uint64_t cellKey(int x, int y, int z) {
+        // 21 bits per axis; far cells may alias, the narrow phase filters them out
+        return (uint64_t(uint32_t(x) & 0x1fffffu) << 42)
+             | (uint64_t(uint32_t(y) & 0x1fffffu) << 21)
+             | uint64_t(uint32_t(z) & 0x1fffffu);
+    }
+
+    void link(const Entry& entry);
+
+    void unlink(const Entry& entry);
+
+public:
+    explicit CollisionWorld(float cell_size) : cell_size(cell_size) {}
+
+    void insert(Id id, unsigned layer, const BBox& box);
+
+    void update(Id id, const BBox& box);
+
+    // Does nothing for unknown ids
+    void remove(Id id);
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    // Calls callback(id_a, id_b) once for every intersecting pair with id_a in layer_a and id_b in layer_b
+    template <typename Callback>
+    void queryPairs(unsigned layer_a, unsigned layer_b, Callback callback) const {
+        if (layer_a >= layers.size()) return;
+
+        for (const auto entry : layers[layer_a]) {
+            const auto& a = *entry;
+
+            for (int x = a.cell_min.x; x <= a.cell_max.x; x++) {
+                for (int y = a.cell_min.y; y <= a.cell_max.y; y++) {
+                    for (int z = a.cell_min.z; z <= a.cell_max.z; z++) {
+                        const auto cell = cells.find(cellKey(x, y, z));
+                        if (cell == cells.end()) continue;
+
+                        for (const auto b : cell->second) {
+                            if (b->layer != layer_b || b->id == a.id) continue;
+                            if (layer_a == layer_b && b->id < a.id) continue;
+                            if (!intersect(a.box, b->box)) continue;
+
+                            // A pair shares several cells, report it only from the one holding the overlap's min corner
+                            if (cellOf(glm::max(a.box.min, b->box.min)) != glm::ivec3(x, y, z)) continue;
+
+                            callback(a.id, b->id);
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
+
+#endif //SPACEOBJECTS_COLLISION_H
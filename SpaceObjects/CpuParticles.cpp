@@ -0,0 +1,310 @@
+#include "CpuParticles.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PARTICLES_SSE
+#include <immintrin.h>
+#endif
+
+#if defined(PARTICLES_SSE) && defined(__GNUC__)
+#define PARTICLES_AVX2
+#endif
+
+namespace {
+
+struct ParticleArrays {
+    float* __restrict x;
+    float* __restrict y;
+    float* __restrict z;
+    float* __restrict vx;
+    float* __restrict vy;
+    float* __restrict vz;
+    float* __restrict age;
+    const float* __restrict life;
+};
+
+typedef void (*UpdateKernel)(const ParticleArrays& p, size_t begin, size_t end, float dt, float damping);
+
+void update_scalar(const ParticleArrays& p, size_t begin, size_t end, float dt, float damping) {
+    for (size_t i = begin; i < end; i++) {
+        if (p.age[i] >= p.life[i]) continue;
+
+        p.x[i] += p.vx[i] * dt;
+        p.y[i] += p.vy[i] * dt;
+        p.z[i] += p.vz[i] * dt;
+        p.vx[i] *= damping;
+        p.vy[i] *= damping;
+        p.vz[i] *= damping;
+        p.age[i] += dt;
+    }
+}
+
+#ifdef PARTICLES_SSE
+// Dead lanes get a zero step and unit damping, so the whole range is processed without branches.
+// SSE2 is part of x86-64, no dispatch needed
+void update_sse(const ParticleArrays& p, size_t begin, size_t end, float dt, float damping) {
+    const auto dt4 = _mm_set1_ps(dt);
+    const auto one = _mm_set1_ps(1.0f);
+    const auto damping4 = _mm_set1_ps(damping);
+
+    for (size_t i = begin; i < end; i += 4) {
+        const auto age = _mm_loadu_ps(p.age + i);
+        const auto alive = _mm_cmplt_ps(age, _mm_loadu_ps(p.life + i));
+
+        const auto step = _mm_and_ps(alive, dt4);
+        const auto damp = _mm_or_ps(_mm_and_ps(alive, damping4), _mm_andnot_ps(alive, one));
+
+        const auto vx = _mm_loadu_ps(p.vx + i);
+        const auto vy = _mm_loadu_ps(p.vy + i);
+        const auto vz = _mm_loadu_ps(p.vz + i);
+
+        _mm_storeu_ps(p.x + i, _mm_add_ps(_mm_loadu_ps(p.x + i), _mm_mul_ps(vx, step)));
+        _mm_storeu_ps(p.y + i, _mm_add_ps(_mm_loadu_ps(p.y + i), _mm_mul_ps(vy, step)));
+        _mm_storeu_ps(p.z + i, _mm_add_ps(_mm_loadu_ps(p.z + i), _mm_mul_ps(vz, step)));
+        _mm_storeu_ps(p.vx + i, _mm_mul_ps(vx, damp));
+        _mm_storeu_ps(p.vy + i, _mm_mul_ps(vy, damp));
+        _mm_storeu_ps(p.vz + i, _mm_mul_ps(vz, damp));
+        _mm_storeu_ps(p.age + i, _mm_add_ps(age, step));
+    }
+}
+#endif
+
+#ifdef PARTICLES_AVX2
+// Built for AVX2 regardless of the compiler flags, only called after checking the CPU
+__attribute__((target("avx2")))
+void update_avx2(const ParticleArrays& p, size_t begin, size_t end, float dt, float damping) {
+    const auto dt8 = _mm256_set1_ps(dt);
+    const auto one = _mm256_set1_ps(1.0f);
+    const auto damping8 = _mm256_set1_ps(damping);
+
+    for (size_t i = begin; i < end; i += 8) {
+        const auto age = _mm256_loadu_ps(p.age + i);
+        const auto alive = _mm256_cmp_ps(age, _mm256_loadu_ps(p.life + i), _CMP_LT_OQ);
+
+        const auto step = _mm256_and_ps(alive, dt8);
+        const auto damp = _mm256_blendv_ps(one, damping8, alive);
+
+        const auto vx = _mm256_loadu_ps(p.vx + i);
+        const auto vy = _mm256_loadu_ps(p.vy + i);
+        const auto vz = _mm256_loadu_ps(p.vz + i);
+
+        _mm256_storeu_ps(p.x + i, _mm256_add_ps(_mm256_loadu_ps(p.x + i), _mm256_mul_ps(vx, step)));
+        _mm256_storeu_ps(p.y + i, _mm256_add_ps(_mm256_loadu_ps(p.y + i), _mm256_mul_ps(vy, step)));
+        _mm256_storeu_ps(p.z + i, _mm256_add_ps(_mm256_loadu_ps(p.z + i), _mm256_mul_ps(vz, step)));
+        _mm256_storeu_ps(p.vx + i, _mm256_mul_ps(vx, damp));
+        _mm256_storeu_ps(p.vy + i, _mm256_mul_ps(vy, damp));
+        _mm256_storeu_ps(p.vz + i, _mm256_mul_ps(vz, damp));
+        _mm256_storeu_ps(p.age + i, _mm256_add_ps(age, step));
+    }
+}
+#endif
+
+struct KernelChoice {
+    UpdateKernel update;
+    const char* name;
+};
+
+KernelChoice select_kernel() {
+#ifdef PARTICLES_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {update_avx2, "AVX2"};
+    }
+#endif
+#ifdef PARTICLES_SSE
+    return {update_sse, "SSE2"};
+#else
+    return {update_scalar, "scalar"};
+#endif
+}
+
+const KernelChoice& kernel() {
+    static const KernelChoice choice = select_kernel();
+    return choice;
+}
+
+size_t round_up(size_t value, size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+} // namespace
+
+constexpr size_t CpuParticlePool::lanes;
+constexpr size_t CpuParticlePool::parallel_threshold;
+
+CpuParticlePool::CpuParticlePool(size_t capacity, unsigned num_threads) :
+    // Padding lets the kernels run over whole vectors past the last live particle
+    x(round_up(capacity, lanes)), y(x.size()), z(x.size()),
+    vx(x.size()), vy(x.size()), vz(x.size()),
+    age(x.size()), life(x.size()),
+    capacity(capacity) {
+
+    vertices.reserve(capacity);
+
+    for (size_t chunk = 1; chunk < std::max(num_threads, 1u); chunk++) {
+        workers.emplace_back(&CpuParticlePool::workerLoop, this, chunk);
+    }
+}
+
+CpuParticlePool::~CpuParticlePool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_ready.notify_all();
+
+    for (auto& thread : workers) {
+        thread.join();
+    }
+}
+
+const char* CpuParticlePool::kernelName() {
+    return kernel().name;
+}
+
+void CpuParticlePool::emit(const ParticleEmission& emission) {
+    const auto spawned = std::min<size_t>(emission.count, capacity - count);
+    dropped += emission.count - spawned;
+
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (size_t k = 0; k < spawned; k++) {
+        auto direction = glm::vec3(2.0f * unit(random) - 1.0f, 2.0f * unit(random) - 1.0f, 2.0f * unit(random) - 1.0f);
+        const auto length = glm::length(direction);
+        direction = length > 1e-6f ? direction / length : glm::vec3(0.0f);
+        const auto velocity = emission.velocity + emission.spread * unit(random) * direction;
+
+        const auto i = count++;
+        x[i] = emission.position.x;
+        y[i] = emission.position.y;
+        z[i] = emission.position.z;
+        vx[i] = velocity.x;
+        vy[i] = velocity.y;
+        vz[i] = velocity.z;
+        age[i] = 0.0f;
+        life[i] = emission.lifetime * (0.5f + 0.5f * unit(random));
+    }
+}
+
+void CpuParticlePool::updateChunk(size_t chunk) {
+    // Chunks are whole vectors, so no two threads write to the same cache line but at the seams
+    const auto end = round_up(count, lanes);
+    const auto chunk_size = round_up((end + job_chunks - 1) / job_chunks, lanes);
+    const auto begin = std::min(chunk * chunk_size, end);
+
+    const ParticleArrays arrays {x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), age.data(), life.data()};
+    kernel().update(arrays, begin, std::min(begin + chunk_size, end), job_dt, std::max(1.0f - ParticleSystem::drag * job_dt, 0.0f));
+}
+
+void CpuParticlePool::workerLoop(size_t chunk) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        work_ready.wait(lock, [&]() { return stopping || generation != seen; });
+        if (stopping) return;
+        seen = generation;
+
+        const auto has_work = chunk < job_chunks;
+        lock.unlock();
+        if (has_work) {
+            updateChunk(chunk);
+        }
+        lock.lock();
+
+        if (--busy_workers == 0) {
+            work_done.notify_one();
+        }
+    }
+}
+
+void CpuParticlePool::advance(float dt) {
+    job_dt = dt;
+
+    if (workers.empty() || count < parallel_threshold) {
+        job_chunks = 1;
+        updateChunk(0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job_chunks = workers.size() + 1;
+        busy_workers = workers.size();
+        generation++;
+    }
+    work_ready.notify_all();
+
+    updateChunk(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    work_done.wait(lock, [this]() { return busy_workers == 0; });
+}
+
+void CpuParticlePool::compact() {
+    vertices.clear();
+
+    size_t i = 0;
+    while (i < count) {
+        if (age[i] < life[i]) {
+            vertices.push_back({{x[i], y[i], z[i]}, age[i], life[i]});
+            i++;
+            continue;
+        }
+
+        // The last particle has not been looked at yet, it takes the hole and is checked next
+        const auto last = --count;
+        x[i] = x[last];
+        y[i] = y[last];
+        z[i] = z[last];
+        vx[i] = vx[last];
+        vy[i] = vy[last];
+        vz[i] = vz[last];
+        age[i] = age[last];
+        life[i] = life[last];
+    }
+}
+
+void CpuParticlePool::update(float dt) {
+    advance(dt);
+    compact();
+}
+
+CpuParticleSystem::CpuParticleSystem(size_t capacity) :
+    pool(capacity),
+    // Three frames of live particles in flight
+    stream(GLsizeiptr(3 * capacity * sizeof(ParticleVertex))) {
+
+    glGenVertexArrays(1, &VAO);
+    gl_state().bindVertexArray(VAO);
+
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, stream.getBuffer());
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ParticleVertex), (GLvoid*) offsetof(ParticleVertex, position));
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(ParticleVertex), (GLvoid*) offsetof(ParticleVertex, age));
+
+    // Location 3 like in the GPU pool, so both backends share the render program
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(ParticleVertex), (GLvoid*) offsetof(ParticleVertex, lifetime));
+
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, 0);
+    gl_state().bindVertexArray(0);
+}
+
+void CpuParticleSystem::draw() {
+    const auto& vertices = pool.liveVertices();
+    if (vertices.empty()) return;
+
+    const auto count = GLsizei(vertices.size());
+    const auto first = stream.write(vertices.data(), count, sizeof(ParticleVertex));
+    if (first >= 0) {
+        gl_state().bindVertexArray(VAO);
+        glDrawArrays(GL_POINTS, first, count);
+    }
+
+    stream.endFrame();
+}
@@ -0,0 +1,127 @@
+#ifndef SPACEOBJECTS_CPUPARTICLES_H
+#define SPACEOBJECTS_CPUPARTICLES_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "ParticleSystem.h"
+#include "StreamBuffer.h"
+
+// What the particle render program reads of a live particle
+struct ParticleVertex {
+    glm::vec3 position;
+    float age;
+    float lifetime;
+};
+
+// Particles as parallel arrays, updated with SIMD over chunks shared between worker threads.
+// Live particles are kept at the front; dead ones are swapped out after each update.
+// No GL involved, so it also runs headless
+class CpuParticlePool {
+public:
+    // Lanes of the widest kernel, arrays are padded to a multiple of it
+    static constexpr size_t lanes = 8;
+
+    std::vector<float> x, y, z;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> age, life;
+
+private:
+    size_t capacity;
+    size_t count = 0;
+    uint64_t dropped = 0;
+    std::minstd_rand random;
+
+    // Live particles after the last update, ready to be uploaded
+    std::vector<ParticleVertex> vertices;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    uint64_t generation = 0;
+    size_t busy_workers = 0;
+    bool stopping = false;
+
+    float job_dt = 0.0f;
+    size_t job_chunks = 1;
+
+    void workerLoop(size_t chunk);
+
+    void updateChunk(size_t chunk);
+
+    void compact();
+
+public:
+    // Below this many live particles the update stays on the calling thread
+    static constexpr size_t parallel_threshold = 16384;
+
+    // num_threads counts the calling thread, which takes a chunk of its own
+    explicit CpuParticlePool(size_t capacity, unsigned num_threads = std::thread::hardware_concurrency());
+
+    ~CpuParticlePool();
+
+    CpuParticlePool(const CpuParticlePool&) = delete;
+    CpuParticlePool& operator=(const CpuParticlePool&) = delete;
+
+    // Particles that do not fit are dropped
+    void emit(const ParticleEmission& emission);
+
+    // Ages and advects every live particle, then removes the dead ones and refills vertices()
+    void update(float dt);
+
+    // Only moves particles, without compaction, for measuring the kernel alone
+    void advance(float dt);
+
+    size_t size() const {
+        return count;
+    }
+
+    uint64_t droppedParticles() const {
+        return dropped;
+    }
+
+    unsigned numThreads() const {
+        return unsigned(workers.size() + 1);
+    }
+
+    const std::vector<ParticleVertex>& liveVertices() const {
+        return vertices;
+    }
+
+    // Instruction set of the update kernel picked for this CPU
+    static const char* kernelName();
+};
+
+// CPU backend of the engine trails and explosions, for drivers where transform feedback is slow
+// (software rasterizers). Live particles are streamed to the GPU every frame
+class CpuParticleSystem : public ParticleBackend {
+    CpuParticlePool pool;
+    StreamBuffer stream;
+    GLuint VAO;
+
+public:
+    explicit CpuParticleSystem(size_t capacity);
+
+    void emit(const ParticleEmission& emission) override {
+        pool.emit(emission);
+    }
+
+    void update(float dt) override {
+        pool.update(dt);
+    }
+
+    void draw() override;
+
+    const CpuParticlePool& getPool() const {
+        return pool;
+    }
+};
+
+#endif //SPACEOBJECTS_CPUPARTICLES_H
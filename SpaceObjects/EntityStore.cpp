@@ -0,0 +1,133 @@
+#include "EntityStore.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+template <typename T>
+void swap_and_pop(std::vector<T>& values, size_t i) {
+    values[i] = values.back();
+    values.pop_back();
+}
+
+} // namespace
+
+void EntityStore::reserve(size_t count) {
+    for (auto values : {&pos_x, &pos_y, &pos_z, &prev_x, &prev_y, &prev_z, &vel_x, &vel_y, &vel_z, &scale, &damage}) {
+        values->reserve(count);
+    }
+    rotation.reserve(count);
+    dying.reserve(count);
+    death_countdown.reserve(count);
+    kind.reserve(count);
+    asset.reserve(count);
+    lod.reserve(count);
+    handle.reserve(count);
+}
+
+EntityStore::Handle EntityStore::spawn(const ModelInstance& model, const glm::vec3& velocity, uint32_t entity_kind) {
+    uint32_t slot;
+    if (!free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    } else {
+        if (slot_generation.size() > slot_mask) {
+            std::cerr << "Entity store is full" << std::endl;
+            return null_handle;
+        }
+        slot = uint32_t(slot_generation.size());
+        slot_generation.push_back(1);
+        slot_index.push_back(0);
+    }
+
+    const auto h = (slot_generation[slot] << slot_bits) | slot;
+    slot_index[slot] = uint32_t(size());
+
+    pos_x.push_back(model.world_pos.x);
+    pos_y.push_back(model.world_pos.y);
+    pos_z.push_back(model.world_pos.z);
+    prev_x.push_back(model.world_pos.x);
+    prev_y.push_back(model.world_pos.y);
+    prev_z.push_back(model.world_pos.z);
+    vel_x.push_back(velocity.x);
+    vel_y.push_back(velocity.y);
+    vel_z.push_back(velocity.z);
+    rotation.push_back(model.rot);
+    scale.push_back(model.scale_coef);
+    damage.push_back(model.damage);
+    dying.push_back(model.dead ? 1 : 0);
+    death_countdown.push_back(model.death_countdown);
+    kind.push_back(entity_kind);
+    asset.push_back(model.asset.get());
+    lod.push_back(0);
+    handle.push_back(h);
+
+    return h;
+}
+
+void EntityStore::remove(Handle h) {
+    if (!valid(h)) return;
+
+    const auto slot = h & slot_mask;
+    const auto i = slot_index[slot];
+
+    swap_and_pop(pos_x, i);
+    swap_and_pop(pos_y, i);
+    swap_and_pop(pos_z, i);
+    swap_and_pop(prev_x, i);
+    swap_and_pop(prev_y, i);
+    swap_and_pop(prev_z, i);
+    swap_and_pop(vel_x, i);
+    swap_and_pop(vel_y, i);
+    swap_and_pop(vel_z, i);
+    swap_and_pop(rotation, i);
+    swap_and_pop(scale, i);
+    swap_and_pop(damage, i);
+    swap_and_pop(dying, i);
+    swap_and_pop(death_countdown, i);
+    swap_and_pop(kind, i);
+    swap_and_pop(asset, i);
+    swap_and_pop(lod, i);
+    swap_and_pop(handle, i);
+
+    if (i < size()) {
+        slot_index[handle[i] & slot_mask] = i;
+    }
+
+    // Generation 0 is reserved so that null_handle is never valid
+    slot_generation[slot] = slot_generation[slot] % (UINT32_MAX >> slot_bits) + 1;
+    free_slots.push_back(slot);
+}
+
+bool EntityStore::valid(Handle h) const {
+    const auto slot = h & slot_mask;
+    return slot < slot_generation.size() && slot_generation[slot] == (h >> slot_bits);
+}
+
+void EntityStore::integrate(float alpha) {
+    const auto count = size();
+
+    std::memcpy(prev_x.data(), pos_x.data(), count * sizeof(float));
+    std::memcpy(prev_y.data(), pos_y.data(), count * sizeof(float));
+    std::memcpy(prev_z.data(), pos_z.data(), count * sizeof(float));
+
+    // Plain loops over separate arrays, so the compiler is free to vectorize them
+    float* __restrict x = pos_x.data();
+    float* __restrict y = pos_y.data();
+    float* __restrict z = pos_z.data();
+    const float* __restrict dx = vel_x.data();
+    const float* __restrict dy = vel_y.data();
+    const float* __restrict dz = vel_z.data();
+    for (size_t i = 0; i < count; i++) {
+        x[i] += alpha * dx[i];
+        y[i] += alpha * dy[i];
+        z[i] += alpha * dz[i];
+    }
+
+    int32_t* __restrict countdown = death_countdown.data();
+    const int32_t* __restrict killed = dying.data();
+    for (size_t i = 0; i < count; i++) {
+        countdown[i] -= killed[i];
+    }
+}
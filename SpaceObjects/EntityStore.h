@@ -0,0 +1,87 @@
+#ifndef SPACEOBJECTS_ENTITYSTORE_H
+#define SPACEOBJECTS_ENTITYSTORE_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/gtx/quaternion.hpp>
+
+#include "BBox.h"
+#include "Model.h"
+
+// Enemies, asteroids and rockets as parallel arrays. Every component of entity i
+// lives at index i of its array; removal moves the last entity into the hole, so the
+// arrays stay dense and a Handle is the only way to refer to an entity across frames.
+// Assets are not owned, they must outlive the store (ModelFactory keeps them for the whole game)
+class EntityStore {
+public:
+    // Slot index in the low 20 bits, slot generation (never 0) in the high 12 bits
+    typedef uint32_t Handle;
+    static const Handle null_handle = 0;
+
+    std::vector<float> pos_x, pos_y, pos_z;
+    std::vector<float> prev_x, prev_y, prev_z; // positions before the last integrate, for interpolated rendering
+    std::vector<float> vel_x, vel_y, vel_z;
+    std::vector<glm::quat> rotation;
+    std::vector<float> scale;
+    std::vector<float> damage;
+    std::vector<int32_t> dying; // 1 once killed; a dying entity keeps drifting until its countdown runs out
+    std::vector<int32_t> death_countdown;
+    std::vector<uint32_t> kind; // caller-defined tag
+    std::vector<const MeshAsset*> asset;
+    std::vector<uint8_t> lod; // level of detail drawn last frame, the renderer switches from it with hysteresis
+    std::vector<Handle> handle;
+
+private:
+    std::vector<uint32_t> slot_index;      // slot -> dense index
+    std::vector<uint32_t> slot_generation;
+    std::vector<uint32_t> free_slots;
+
+public:
+    size_t size() const {
+        return handle.size();
+    }
+
+    void reserve(size_t count);
+
+    Handle spawn(const ModelInstance& model, const glm::vec3& velocity, uint32_t kind);
+
+    // Invalidates the handle and moves the last entity into its place
+    void remove(Handle h);
+
+    bool valid(Handle h) const;
+
+    // Dense index of a valid handle
+    size_t indexOf(Handle h) const {
+        return slot_index[h & slot_mask];
+    }
+
+    glm::vec3 position(size_t i) const {
+        return {pos_x[i], pos_y[i], pos_z[i]};
+    }
+
+    // Position alpha of the way from the previous step to the current one
+    glm::vec3 position(size_t i, float alpha) const {
+        return glm::mix(glm::vec3(prev_x[i], prev_y[i], prev_z[i]), position(i), alpha);
+    }
+
+    glm::mat4 worldTransform(size_t i) const {
+        return worldTransform(i, position(i));
+    }
+
+    glm::mat4 worldTransform(size_t i, const glm::vec3& world_pos) const {
+        return glm::translate(glm::mat4(1.0f), world_pos) * glm::toMat4(rotation[i]) * glm::scale(glm::mat4(1.0f), glm::vec3(scale[i]));
+    }
+
+    BBox bbox(size_t i) const {
+        return asset[i]->bbox.transformed(worldTransform(i));
+    }
+
+    // One simulation step: moves every entity by alpha * velocity and ticks explosions
+    void integrate(float alpha);
+
+private:
+    static const uint32_t slot_bits = 20;
+    static const uint32_t slot_mask = (1u << slot_bits) - 1;
+};
+
+#endif //SPACEOBJECTS_ENTITYSTORE_H
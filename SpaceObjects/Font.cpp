@@ -1,106 +1,258 @@
 #include "Font.h"
+#include "GLState.h"
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <glm/glm.hpp>
 
-Font::Font(const std::string &path) {
+namespace {
+
+constexpr int ATLAS_WIDTH = 1024;
+constexpr int GLYPH_PADDING = 1;
+
+struct GlyphBitmap {
+    uint32_t code_point;
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;
+};
+
+// Next code point of a UTF-8 string, invalid bytes decode to '?'
+uint32_t next_code_point(const std::string& text, size_t& i) {
+    const auto lead = static_cast<unsigned char>(text[i++]);
+    if (lead < 0x80) return lead;
+
+    int length;
+    uint32_t code_point;
+    if ((lead & 0xe0) == 0xc0) {
+        length = 1;
+        code_point = lead & 0x1fu;
+    } else if ((lead & 0xf0) == 0xe0) {
+        length = 2;
+        code_point = lead & 0x0fu;
+    } else if ((lead & 0xf8) == 0xf0) {
+        length = 3;
+        code_point = lead & 0x07u;
+    } else {
+        return '?';
+    }
+
+    for (int k = 0; k < length; k++) {
+        if (i >= text.size() || (static_cast<unsigned char>(text[i]) & 0xc0) != 0x80) return '?';
+        code_point = (code_point << 6) | (static_cast<unsigned char>(text[i++]) & 0x3fu);
+    }
+    return code_point;
+}
+
+GLuint create_text_vertex_array(GLuint buffer) {
+    GLuint VAO;
+    glGenVertexArrays(1, &VAO);
+
+    gl_state().bindVertexArray(VAO);
+
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(TextVertex), nullptr);
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (GLvoid*) offsetof(TextVertex, color));
+
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    gl_state().bindVertexArray(0);
+
+    return VAO;
+}
+
+void draw_text(GLuint VAO, GLuint atlas, GLint first, GLsizei num_vertices) {
+    gl_state().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, atlas);
+    gl_state().bindVertexArray(VAO);
+
+    glDrawArrays(GL_TRIANGLES, first, num_vertices);
+}
+
+} // namespace
+
+Font::Font(const std::string &path, const std::vector<Range>& ranges) : atlas(0) {
     FT_Library ft_lib;
     const auto res_lib = FT_Init_FreeType(&ft_lib);
     if (res_lib != 0) {
         std::cerr << "Error initializing freetype" << std::endl;
+        return;
     }
 
     FT_Face ft_face;
     const auto res_face = FT_New_Face(ft_lib, path.c_str(), 0, &ft_face);
     if (res_face != 0) {
         std::cerr << "Error loading font" << std::endl;
+        FT_Done_FreeType(ft_lib);
+        return;
     }
 
     FT_Set_Pixel_Sizes(ft_face, 0, 48);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-    for (unsigned char ch = 0; ch < 128; ch++) {
-        const auto res_char = FT_Load_Char(ft_face, ch, FT_LOAD_RENDER);
-        if (res_char != 0) {
-            std::cerr << "Error loading character" << std::endl;
-        }
+    // Rasterize everything first, then pack the bitmaps into shelves
+    std::vector<GlyphBitmap> bitmaps;
+    for (const auto& range : ranges) {
+        for (uint32_t code_point = range.first; code_point <= range.second; code_point++) {
+            if (FT_Get_Char_Index(ft_face, code_point) == 0) continue;
 
-        const auto width = ft_face->glyph->bitmap.width;
-        const auto height = ft_face->glyph->bitmap.rows;
-        const auto data = ft_face->glyph->bitmap.buffer;
-        const GLuint shift = ft_face->glyph->advance.x;
-        const auto offset_x = ft_face->glyph->bitmap_left;
-        const auto offset_y = ft_face->glyph->bitmap_top;
+            const auto res_char = FT_Load_Char(ft_face, code_point, FT_LOAD_RENDER);
+            if (res_char != 0) {
+                std::cerr << "Error loading character " << code_point << std::endl;
+                continue;
+            }
 
-        GLuint texture_id;
-        glGenTextures(1, &texture_id);
-        glBindTexture(GL_TEXTURE_2D, texture_id);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, data);
+            const auto glyph = ft_face->glyph;
+            const auto& bitmap = glyph->bitmap;
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            GlyphBitmap item {code_point, int(bitmap.width), int(bitmap.rows), {}};
+            item.pixels.resize(size_t(item.width) * item.height);
+            for (int row = 0; row < item.height; row++) {
+                std::memcpy(&item.pixels[size_t(row) * item.width], bitmap.buffer + row * bitmap.pitch, size_t(item.width));
+            }
+            bitmaps.push_back(std::move(item));
 
-        chars[ch] = {texture_id, shift, {width, height}, {offset_x, offset_y}};
+            glyphs[code_point] = {{bitmap.width, bitmap.rows},
+                                  {glyph->bitmap_left, glyph->bitmap_top},
+                                  float(glyph->advance.x >> 6),
+                                  {}, {}};
+        }
     }
 
     FT_Done_Face(ft_face);
     FT_Done_FreeType(ft_lib);
 
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    std::vector<glm::ivec2> origins;
+    int shelf_x = GLYPH_PADDING;
+    int shelf_y = GLYPH_PADDING;
+    int shelf_height = 0;
+    for (const auto& bitmap : bitmaps) {
+        if (shelf_x + bitmap.width + GLYPH_PADDING > ATLAS_WIDTH) {
+            shelf_x = GLYPH_PADDING;
+            shelf_y += shelf_height + GLYPH_PADDING;
+            shelf_height = 0;
+        }
+        origins.emplace_back(shelf_x, shelf_y);
+        shelf_x += bitmap.width + GLYPH_PADDING;
+        shelf_height = std::max(shelf_height, bitmap.height);
+    }
 
-    glBindVertexArray(VAO);
+    int atlas_height = 1;
+    while (atlas_height < shelf_y + shelf_height + GLYPH_PADDING) {
+        atlas_height *= 2;
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, 6 * 4 * sizeof(GLfloat), nullptr, GL_DYNAMIC_DRAW);
+    std::vector<unsigned char> pixels(size_t(ATLAS_WIDTH) * atlas_height, 0);
+    for (size_t i = 0; i < bitmaps.size(); i++) {
+        const auto& bitmap = bitmaps[i];
+        const auto origin = origins[i];
+        for (int row = 0; row < bitmap.height; row++) {
+            std::memcpy(&pixels[size_t(origin.y + row) * ATLAS_WIDTH + origin.x],
+                        &bitmap.pixels[size_t(row) * bitmap.width], size_t(bitmap.width));
+        }
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), nullptr);
+        const glm::vec2 atlas_size(ATLAS_WIDTH, atlas_height);
+        auto& glyph = glyphs[bitmap.code_point];
+        glyph.uv_min = glm::vec2(origin.x, origin.y) / atlas_size;
+        glyph.uv_max = glm::vec2(origin.x + bitmap.width, origin.y + bitmap.height) / atlas_size;
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-    glBindVertexArray(0);
-}
+    glGenTextures(1, &atlas);
+    gl_state().bindTexture(GL_TEXTURE_2D, atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, ATLAS_WIDTH, atlas_height, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
 
-void Font::draw(const std::string &text) const {
-    glActiveTexture(GL_TEXTURE0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    glBindVertexArray(VAO);
+    gl_state().bindTexture(GL_TEXTURE_2D, 0);
+}
 
-    float cursor = 0.0f;
-    for (const auto& sym : text) {
-        const auto ch = chars[sym];
+const Font::Glyph* Font::findGlyph(uint32_t code_point) const {
+    auto it = glyphs.find(code_point);
+    if (it == glyphs.end()) {
+        it = glyphs.find('?');
+    }
+    return it != glyphs.end() ? &it->second : nullptr;
+}
 
-        const auto texture_id = ch.texture_id;
-        const auto width = ch.size.x;
-        const auto height = ch.size.y;
+void Font::layout(const std::string& text, const glm::vec2& position, float scale, const glm::vec3& color,
+                  std::vector<TextVertex>& vertices) const {
+    float cursor = 0.0f;
+    for (size_t i = 0; i < text.size();) {
+        const auto glyph = findGlyph(next_code_point(text, i));
+        if (glyph == nullptr) continue;
 
-        const auto xpos = cursor + ch.offset.x;
-        const auto ypos = ch.offset.y - ch.size.y;
+        const auto min = position + scale * glm::vec2(cursor + glyph->offset.x, glyph->offset.y - glyph->size.y);
+        const auto max = min + scale * glyph->size;
 
-        const GLfloat vertices[] = {
-            xpos, ypos + height, 0.0, 0.0,
-            xpos, ypos, 0.0, 1.0f,
-            xpos + width, ypos, 1.0f, 1.0f,
+        // Bitmaps are stored top row first
+        const TextVertex quad[] = {
+            {{min.x, max.y}, {glyph->uv_min.x, glyph->uv_min.y}, color},
+            {{min.x, min.y}, {glyph->uv_min.x, glyph->uv_max.y}, color},
+            {{max.x, min.y}, {glyph->uv_max.x, glyph->uv_max.y}, color},
 
-            xpos, ypos + height, 0.0, 0.0,
-            xpos + width, ypos, 1.0, 1.0f,
-            xpos + width, ypos + height, 1.0f, 0.0f,
+            {{min.x, max.y}, {glyph->uv_min.x, glyph->uv_min.y}, color},
+            {{max.x, min.y}, {glyph->uv_max.x, glyph->uv_max.y}, color},
+            {{max.x, max.y}, {glyph->uv_max.x, glyph->uv_min.y}, color},
         };
+        vertices.insert(vertices.end(), std::begin(quad), std::end(quad));
 
-        glBindTexture(GL_TEXTURE_2D, texture_id);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        cursor += glyph->advance;
+    }
+}
+
+TextBatch::TextBatch(const Font& font, StreamBuffer& stream) :
+    font(font),
+    stream(stream),
+    VAO(create_text_vertex_array(stream.getBuffer())) {}
+
+void TextBatch::flush() {
+    if (vertices.empty()) return;
+
+    const auto count = GLsizei(vertices.size());
+    const auto first = stream.write(vertices.data(), count, sizeof(TextVertex));
+    if (first >= 0) {
+        draw_text(VAO, font.getAtlas(), first, count);
+    }
+
+    vertices.clear();
+}
+
+TextLayout::TextLayout(const Font& font, const glm::vec2& position, const glm::vec3& color, float scale) :
+    font(font),
+    position(position),
+    color(color),
+    scale(scale) {
 
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+    glGenBuffers(1, &VBO);
+    VAO = create_text_vertex_array(VBO);
+}
 
-        cursor += ch.shift >> 6;
+void TextLayout::draw() {
+    if (dirty) {
+        vertices.clear();
+        font.layout(text, position, scale, color, vertices);
+        num_vertices = GLsizei(vertices.size());
+
+        gl_state().bindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(TextVertex), vertices.data(), GL_DYNAMIC_DRAW);
+        gl_state().bindBuffer(GL_ARRAY_BUFFER, 0);
+
+        dirty = false;
     }
 
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    if (num_vertices != 0) {
+        draw_text(VAO, font.getAtlas(), 0, num_vertices);
+    }
 }
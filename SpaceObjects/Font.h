@@ -1,25 +1,135 @@
 #ifndef SPACEOBJECTS_FONT_H
 #define SPACEOBJECTS_FONT_H
 
-#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <glad/glad.h>
 #include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
 
+#include "StreamBuffer.h"
+
+struct TextVertex {
+    glm::vec2 position;
+    glm::vec2 tex_coords;
+    glm::vec3 color;
+};
+
+// All glyphs of the requested code point ranges rasterized into one texture
 class Font {
-    struct Character {
-        GLuint texture_id;
-        GLuint shift;
+    struct Glyph {
         glm::vec2 size;
         glm::vec2 offset;
+        float advance;
+        glm::vec2 uv_min;
+        glm::vec2 uv_max;
     };
 
-    std::array<Character, 128> chars;
+    std::unordered_map<uint32_t, Glyph> glyphs;
+    GLuint atlas;
+
+    const Glyph* findGlyph(uint32_t code_point) const;
+
+public:
+    // Inclusive range of Unicode code points
+    typedef std::pair<uint32_t, uint32_t> Range;
+
+    explicit Font(const std::string& path, const std::vector<Range>& ranges = {{32, 126}});
+
+    GLuint getAtlas() const {
+        return atlas;
+    }
+
+    // Appends six vertices per glyph of the UTF-8 text, starting at position on the baseline.
+    // Code points outside the atlas are drawn as '?'
+    void layout(const std::string& text, const glm::vec2& position, float scale, const glm::vec3& color,
+                std::vector<TextVertex>& vertices) const;
+};
+
+// Collects the text of a frame and draws it with a single call from the stream buffer
+class TextBatch {
+    const Font& font;
+    StreamBuffer& stream;
+    GLuint VAO;
+    std::vector<TextVertex> vertices;
+
+public:
+    TextBatch(const Font& font, StreamBuffer& stream);
+
+    TextBatch(const TextBatch&) = delete;
+    TextBatch& operator=(const TextBatch&) = delete;
+
+    void add(const std::string& text, const glm::vec2& position, const glm::vec3& color, float scale = 1.0f) {
+        font.layout(text, position, scale, color, vertices);
+    }
+
+    // Expects the text program to be in use
+    void flush();
+
+    void draw() {
+        flush();
+    }
+};
+
+// Text whose quads stay in a GPU buffer of their own between frames.
+// Layout and upload only happen after the content changes
+class TextLayout {
+    const Font& font;
     GLuint VAO, VBO;
+
+    glm::vec2 position;
+    glm::vec3 color;
+    float scale;
+
+    std::string text;
+    bool dirty = false;
+    GLsizei num_vertices = 0;
+    std::vector<TextVertex> vertices;
+
 public:
-    explicit Font(const std::string& path);
+    TextLayout(const Font& font, const glm::vec2& position, const glm::vec3& color, float scale = 1.0f);
+
+    TextLayout(const TextLayout&) = delete;
+    TextLayout& operator=(const TextLayout&) = delete;
+
+    // Does nothing if the text is unchanged
+    void setText(const std::string& new_text) {
+        if (new_text == text) return;
+
+        text = new_text;
+        dirty = true;
+    }
+
+    // Expects the text program to be in use
+    void draw();
+};
+
+// Label followed by a number, such as "Score: 42". Only a new value builds a new string
+class CounterText {
+    TextLayout layout;
+    std::string label;
+    int value = 0;
+    bool has_value = false;
+
+public:
+    CounterText(const Font& font, const std::string& label, const glm::vec2& position, const glm::vec3& color, float scale = 1.0f) :
+        layout(font, position, color, scale),
+        label(label) {}
+
+    void setValue(int new_value) {
+        if (has_value && new_value == value) return;
 
-    void draw(const std::string& text) const;
+        value = new_value;
+        has_value = true;
+        layout.setText(label + std::to_string(value));
+    }
 
+    void draw() {
+        layout.draw();
+    }
 };
 
 #endif //SPACEOBJECTS_FONT_H
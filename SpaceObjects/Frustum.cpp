@@ -0,0 +1,121 @@
+#include "Frustum.h"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CULLING_SSE
+#include <immintrin.h>
+#endif
+
+constexpr size_t FrustumCuller::lanes;
+
+Frustum::Frustum(const glm::mat4& view_projection) {
+    // Rows of the matrix; a point is inside when -w <= x, y, z <= w in clip space
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+    }
+
+    planes[LEFT] = rows[3] + rows[0];
+    planes[RIGHT] = rows[3] - rows[0];
+    planes[BOTTOM] = rows[3] + rows[1];
+    planes[TOP] = rows[3] - rows[1];
+    planes[NEAREST] = rows[3] + rows[2];
+    planes[FARTHEST] = rows[3] - rows[2];
+
+    for (auto& plane : planes) {
+        plane = plane / glm::length(glm::vec3(plane));
+    }
+}
+
+bool Frustum::intersects(const BBox& bbox) const {
+    const auto center = 0.5f * (bbox.min + bbox.max);
+    const auto extent = 0.5f * (bbox.max - bbox.min);
+
+    for (const auto& plane : planes) {
+        const auto normal = glm::vec3(plane);
+        // Distance of the box corner furthest along the normal
+        if (glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), extent) < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+float projected_size(const BBox& bbox, const glm::vec3& eye, float focal_length) {
+    const auto diameter = glm::length(bbox.max - bbox.min);
+    const auto distance = glm::length(0.5f * (bbox.min + bbox.max) - eye);
+
+    // Close enough to touch the sphere, as large as it gets
+    if (distance <= 0.5f * diameter) return INFINITY;
+
+    return diameter / distance * focal_length;
+}
+
+size_t FrustumCuller::add(const BBox& bbox) {
+    // Padding to whole vectors lets cull() skip a scalar tail
+    if (count == center_x.size()) {
+        const auto size = count + lanes;
+        for (auto array : {&center_x, &center_y, &center_z, &extent_x, &extent_y, &extent_z}) {
+            array->resize(size, 0.0f);
+        }
+        visible_flags.resize(size);
+    }
+
+    const auto center = 0.5f * (bbox.min + bbox.max);
+    const auto extent = 0.5f * (bbox.max - bbox.min);
+    center_x[count] = center.x;
+    center_y[count] = center.y;
+    center_z[count] = center.z;
+    extent_x[count] = extent.x;
+    extent_y[count] = extent.y;
+    extent_z[count] = extent.z;
+
+    return count++;
+}
+
+void FrustumCuller::cull(const Frustum& frustum) {
+#ifdef CULLING_SSE
+    for (size_t i = 0; i < count; i += lanes) {
+        const auto cx = _mm_loadu_ps(center_x.data() + i);
+        const auto cy = _mm_loadu_ps(center_y.data() + i);
+        const auto cz = _mm_loadu_ps(center_z.data() + i);
+        const auto ex = _mm_loadu_ps(extent_x.data() + i);
+        const auto ey = _mm_loadu_ps(extent_y.data() + i);
+        const auto ez = _mm_loadu_ps(extent_z.data() + i);
+
+        auto outside = _mm_setzero_ps();
+        for (const auto& plane : frustum.planes) {
+            const auto distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+                _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+            const auto radius = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(glm::abs(plane.x))), _mm_mul_ps(ey, _mm_set1_ps(glm::abs(plane.y)))),
+                _mm_mul_ps(ez, _mm_set1_ps(glm::abs(plane.z))));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+
+        const auto mask = _mm_movemask_ps(outside);
+        for (size_t lane = 0; lane < lanes; lane++) {
+            visible_flags[i + lane] = uint8_t(((mask >> lane) & 1) == 0);
+        }
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        const BBox bbox(glm::vec3(center_x[i] - extent_x[i], center_y[i] - extent_y[i], center_z[i] - extent_z[i]),
+                        glm::vec3(center_x[i] + extent_x[i], center_y[i] + extent_y[i], center_z[i] + extent_z[i]));
+        visible_flags[i] = uint8_t(frustum.intersects(bbox));
+    }
+#endif
+
+    CullStats stats;
+    stats.tested = int(count);
+    for (size_t i = 0; i < count; i++) {
+        stats.culled += 1 - visible_flags[i];
+    }
+
+    last_stats = stats;
+    total_stats.tested += stats.tested;
+    total_stats.culled += stats.culled;
+    frames++;
+}
@@ -0,0 +1,86 @@
+#ifndef SPACEOBJECTS_FRUSTUM_H
+#define SPACEOBJECTS_FRUSTUM_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "BBox.h"
+
+// Six planes bounding what a view-projection matrix maps into clip space.
+// Each plane is (normal, distance) with the normal pointing inwards and of unit length
+struct Frustum {
+    enum Plane {
+        LEFT,
+        RIGHT,
+        BOTTOM,
+        TOP,
+        NEAREST,
+        FARTHEST,
+        NUM_PLANES,
+    };
+
+    glm::vec4 planes[NUM_PLANES];
+
+    Frustum() = default;
+
+    explicit Frustum(const glm::mat4& view_projection);
+
+    // Conservative: a box near a corner of the frustum may pass without being seen
+    bool intersects(const BBox& bbox) const;
+};
+
+// Height in pixels of the sphere around the box, seen from eye through a lens with the given
+// focal length in pixels (viewport height / 2 / tan(vertical fov / 2))
+float projected_size(const BBox& bbox, const glm::vec3& eye, float focal_length);
+
+// Bounds tested in the last cull() and how many of them were outside the frustum
+struct CullStats {
+    int tested = 0;
+    int culled = 0;
+};
+
+// World bounds of a frame's entities as parallel center/extent arrays, tested against
+// the frustum four boxes at a time. Index i of visible() belongs to the i-th added box
+class FrustumCuller {
+public:
+    static constexpr size_t lanes = 4;
+
+private:
+    std::vector<float> center_x, center_y, center_z;
+    std::vector<float> extent_x, extent_y, extent_z;
+    std::vector<uint8_t> visible_flags;
+    size_t count = 0;
+
+    CullStats last_stats;
+    CullStats total_stats;
+    int frames = 0;
+
+public:
+    void clear() {
+        count = 0;
+    }
+
+    size_t add(const BBox& bbox);
+
+    void cull(const Frustum& frustum);
+
+    bool visible(size_t i) const {
+        return visible_flags[i] != 0;
+    }
+
+    const CullStats& lastStats() const {
+        return last_stats;
+    }
+
+    // Sums over all culled frames
+    const CullStats& totalStats() const {
+        return total_stats;
+    }
+
+    int numFrames() const {
+        return frames;
+    }
+};
+
+#endif //SPACEOBJECTS_FRUSTUM_H
@@ -0,0 +1,211 @@
+#include "GLState.h"
+
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+constexpr GLuint UNKNOWN_NAME = ~0u;
+constexpr GLenum UNKNOWN_ENUM = ~0u;
+
+int texture_target_index(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_CUBE_MAP: return 1;
+        case GL_TEXTURE_2D_ARRAY: return 2;
+        default: return -1;
+    }
+}
+
+#ifdef GL_STATE_VALIDATE
+GLenum texture_binding(int target_index) {
+    const GLenum bindings[] = {GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_CUBE_MAP, GL_TEXTURE_BINDING_2D_ARRAY};
+    return bindings[target_index];
+}
+#endif
+
+int capability_index(GLenum capability) {
+    switch (capability) {
+        case GL_DEPTH_TEST: return 0;
+        case GL_BLEND: return 1;
+        case GL_MULTISAMPLE: return 2;
+        case GL_PROGRAM_POINT_SIZE: return 3;
+        case GL_RASTERIZER_DISCARD: return 4;
+        default: return -1;
+    }
+}
+
+#ifdef GL_STATE_VALIDATE
+const GLenum capability_enums[] = {GL_DEPTH_TEST, GL_BLEND, GL_MULTISAMPLE, GL_PROGRAM_POINT_SIZE, GL_RASTERIZER_DISCARD};
+
+GLuint get_name(GLenum binding) {
+    GLint value;
+    glGetIntegerv(binding, &value);
+    return GLuint(value);
+}
+#endif
+
+} // namespace
+
+constexpr int GLState::max_texture_units;
+
+GLState& gl_state() {
+    static GLState state;
+    return state;
+}
+
+void GLState::invalidate() {
+    program = UNKNOWN_NAME;
+    vertex_array = UNKNOWN_NAME;
+    array_buffer = UNKNOWN_NAME;
+    active_texture = UNKNOWN_ENUM;
+    for (auto& unit : textures) {
+        for (auto& texture : unit) {
+            texture = UNKNOWN_NAME;
+        }
+    }
+    for (auto& capability : capabilities) {
+        capability = -1;
+    }
+    depth_mask = -1;
+    blend_src = blend_dst = UNKNOWN_ENUM;
+    line_width = NAN;
+}
+
+void GLState::useProgram(GLuint name) {
+    if (!changed(program == name)) return;
+
+    program = name;
+    glUseProgram(name);
+    validate("glUseProgram");
+}
+
+void GLState::deleteProgram(GLuint name) {
+    if (program == name) {
+        program = UNKNOWN_NAME;
+    }
+    glDeleteProgram(name);
+}
+
+void GLState::bindVertexArray(GLuint name) {
+    if (!changed(vertex_array == name)) return;
+
+    vertex_array = name;
+    glBindVertexArray(name);
+    validate("glBindVertexArray");
+}
+
+void GLState::bindBuffer(GLenum target, GLuint name) {
+    if (target != GL_ARRAY_BUFFER) {
+        glBindBuffer(target, name);
+        return;
+    }
+    if (!changed(array_buffer == name)) return;
+
+    array_buffer = name;
+    glBindBuffer(target, name);
+    validate("glBindBuffer");
+}
+
+void GLState::activeTexture(GLenum unit) {
+    if (!changed(active_texture == unit)) return;
+
+    active_texture = unit;
+    glActiveTexture(unit);
+    validate("glActiveTexture");
+}
+
+void GLState::bindTexture(GLenum target, GLuint name) {
+    const auto target_index = texture_target_index(target);
+    const auto unit = int(active_texture - GL_TEXTURE0);
+    if (target_index < 0 || active_texture == UNKNOWN_ENUM || unit >= max_texture_units) {
+        glBindTexture(target, name);
+        return;
+    }
+
+    auto& bound = textures[unit][target_index];
+    if (!changed(bound == name)) return;
+
+    bound = name;
+    glBindTexture(target, name);
+    validate("glBindTexture");
+}
+
+void GLState::setEnabled(GLenum capability, bool enabled) {
+    const auto index = capability_index(capability);
+    if (index >= 0) {
+        if (!changed(capabilities[index] == int(enabled))) return;
+        capabilities[index] = int(enabled);
+    }
+
+    if (enabled) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+    validate(enabled ? "glEnable" : "glDisable");
+}
+
+void GLState::depthMask(bool enabled) {
+    if (!changed(depth_mask == int(enabled))) return;
+
+    depth_mask = int(enabled);
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    validate("glDepthMask");
+}
+
+void GLState::blendFunc(GLenum src, GLenum dst) {
+    if (!changed(blend_src == src && blend_dst == dst)) return;
+
+    blend_src = src;
+    blend_dst = dst;
+    glBlendFunc(src, dst);
+    validate("glBlendFunc");
+}
+
+void GLState::lineWidth(float width) {
+    if (!changed(line_width == width)) return;
+
+    line_width = width;
+    glLineWidth(width);
+    validate("glLineWidth");
+}
+
+#ifdef GL_STATE_VALIDATE
+void GLState::validate(const char* operation) const {
+    const auto check = [operation](const char* what, long long expected, long long actual) {
+        if (expected != actual) {
+            std::cerr << "GL state cache out of sync after " << operation << ": " << what
+                      << " is " << actual << ", expected " << expected << std::endl;
+        }
+    };
+
+    if (program != UNKNOWN_NAME) check("program", program, get_name(GL_CURRENT_PROGRAM));
+    if (vertex_array != UNKNOWN_NAME) check("vertex array", vertex_array, get_name(GL_VERTEX_ARRAY_BINDING));
+    if (array_buffer != UNKNOWN_NAME) check("array buffer", array_buffer, get_name(GL_ARRAY_BUFFER_BINDING));
+
+    if (active_texture != UNKNOWN_ENUM) {
+        check("active texture", active_texture, get_name(GL_ACTIVE_TEXTURE));
+
+        // Other units would have to be made active to be read
+        const auto unit = int(active_texture - GL_TEXTURE0);
+        for (int target = 0; unit < max_texture_units && target < NUM_TEXTURE_TARGETS; target++) {
+            if (textures[unit][target] != UNKNOWN_NAME) {
+                check("texture", textures[unit][target], get_name(texture_binding(target)));
+            }
+        }
+    }
+
+    for (int i = 0; i < NUM_CAPABILITIES; i++) {
+        if (capabilities[i] >= 0) check("capability", capabilities[i], glIsEnabled(capability_enums[i]));
+    }
+
+    if (depth_mask >= 0) check("depth mask", depth_mask, get_name(GL_DEPTH_WRITEMASK));
+    if (blend_src != UNKNOWN_ENUM) check("blend source", blend_src, get_name(GL_BLEND_SRC_RGB));
+    if (blend_dst != UNKNOWN_ENUM) check("blend destination", blend_dst, get_name(GL_BLEND_DST_RGB));
+
+    // Line width is left out, drivers are free to clamp wide lines
+}
+#else
+void GLState::validate(const char*) const {}
+#endif
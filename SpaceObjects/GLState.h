@@ -0,0 +1,116 @@
+#ifndef SPACEOBJECTS_GLSTATE_H
+#define SPACEOBJECTS_GLSTATE_H
+
+#include <glad/glad.h>
+
+// State changes requested through the cache and how many of them were dropped as no-ops
+struct GLStateStats {
+    int calls = 0;
+    int skipped = 0;
+};
+
+// Shadow copy of the GL state the game changes, so that setting what is already set costs
+// no driver call. Draws leave their bindings in place instead of resetting them to 0.
+// The tracked state must only be changed through here; after anything else that changes it
+// (deleting a bound object, third-party code) call invalidate().
+// Building with GL_STATE_VALIDATE checks the shadow against glGet* after every change
+class GLState {
+public:
+    static constexpr int max_texture_units = 16;
+
+private:
+    // Texture targets with a shadow, other targets are passed through
+    enum TextureTarget {
+        TEXTURE_2D,
+        TEXTURE_CUBE_MAP,
+        TEXTURE_2D_ARRAY,
+        NUM_TEXTURE_TARGETS,
+    };
+
+    // Capabilities with a shadow, others are passed through
+    enum Capability {
+        DEPTH_TEST,
+        BLEND,
+        MULTISAMPLE,
+        PROGRAM_POINT_SIZE,
+        RASTERIZER_DISCARD,
+        NUM_CAPABILITIES,
+    };
+
+    GLuint program;
+    GLuint vertex_array;
+    GLuint array_buffer;
+    GLenum active_texture;
+    GLuint textures[max_texture_units][NUM_TEXTURE_TARGETS];
+    int capabilities[NUM_CAPABILITIES]; // -1 while unknown
+    int depth_mask;
+    GLenum blend_src, blend_dst;
+    float line_width;
+
+    GLStateStats stats;
+    GLStateStats last_frame_stats;
+
+    // False when the call can be dropped
+    bool changed(bool same) {
+        stats.calls++;
+        if (same) stats.skipped++;
+        return !same;
+    }
+
+    void validate(const char* operation) const;
+
+public:
+    GLState() {
+        invalidate();
+    }
+
+    GLState(const GLState&) = delete;
+    GLState& operator=(const GLState&) = delete;
+
+    // Forgets everything, the next change of each kind always reaches GL
+    void invalidate();
+
+    void useProgram(GLuint name);
+
+    // GL may hand the name of a deleted program to the next one created, so a deleted current
+    // program must not stay in the shadow
+    void deleteProgram(GLuint name);
+
+    void bindVertexArray(GLuint name);
+
+    // Only GL_ARRAY_BUFFER is shadowed: the element array binding belongs to the vertex array
+    void bindBuffer(GLenum target, GLuint name);
+
+    void activeTexture(GLenum unit);
+
+    // Binds to the active unit
+    void bindTexture(GLenum target, GLuint name);
+
+    void bindTexture(GLenum unit, GLenum target, GLuint name) {
+        activeTexture(unit);
+        bindTexture(target, name);
+    }
+
+    void setEnabled(GLenum capability, bool enabled);
+
+    void depthMask(bool enabled);
+
+    void blendFunc(GLenum src, GLenum dst);
+
+    void lineWidth(float width);
+
+    // Stats of the frame just finished become lastFrameStats()
+    void endFrame() {
+        last_frame_stats = stats;
+        stats = GLStateStats();
+    }
+
+    const GLStateStats& lastFrameStats() const {
+        return last_frame_stats;
+    }
+};
+
+// The one GL context of the game
+GLState& gl_state();
+
+#endif //SPACEOBJECTS_GLSTATE_H
@@ -0,0 +1,511 @@
+#include "Headless.h"
+#include "Camera.h"
+#include "CpuParticles.h"
+#include "MeshOptimize.h"
+#include "Simulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <map>
+#include <unordered_map>
+
+namespace {
+
+// Lens of the game window, for culling and picking levels of detail as the renderer would
+const auto projection = glm::perspective(glm::radians(45.0f), 1280.0f / 720.0f, 0.1f, 1000.0f);
+const auto focal_length = 720.0f / (2.0f * std::tan(glm::radians(45.0f) / 2.0f));
+
+// Strafes left and right every two seconds and fires at one of the entities three times a second
+TickInput scripted_input(const Simulation& simulation, Camera& camera, uint64_t tick) {
+    TickInput input;
+    input.step = glm::vec3((tick / 120) % 2 == 0 ? -0.1f : 0.1f, 0.0f, 0.0f);
+
+    const auto& entities = simulation.entities;
+    if (tick % 20 == 0 && entities.size() != 0) {
+        const auto target = entities.position(size_t(tick / 20 % entities.size()));
+
+        camera.position = simulation.camera_position;
+        const auto eye = glm::vec3(glm::inverse(camera.getViewTransform())[3]);
+
+        input.shoot = true;
+        input.aim = {eye, 1000.0f * glm::normalize(target - eye)};
+    }
+
+    return input;
+}
+
+// Seconds spent in the update kernel alone, the pool is full of particles that outlive the run
+double time_particle_updates(size_t num_particles, unsigned num_frames, unsigned num_threads) {
+    CpuParticlePool pool(num_particles, num_threads);
+    pool.emit({glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), 10.0f, 1e6f, uint32_t(num_particles)});
+
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned frame = 0; frame < num_frames; frame++) {
+        pool.advance(1.0f / 60.0f);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+float random_unit() {
+    return float(rand()) / RAND_MAX;
+}
+
+glm::vec3 random_point(float extent) {
+    return extent * glm::vec3(2.0f * random_unit() - 1.0f, 2.0f * random_unit() - 1.0f, 2.0f * random_unit() - 1.0f);
+}
+
+BBox box_around(const glm::vec3& center, float half_size) {
+    return BBox(center - glm::vec3(half_size), center + glm::vec3(half_size));
+}
+
+const char* const model_names[] = {"E45_AIRCRAFT", "ROCKET", "REPVENATOR", "FIGHTER", "DEATHROW", "MYST_ASTEROID", "ASTEROID1"};
+
+bool same_bbox(const BBox& a, const BBox& b) {
+    return a.min == b.min && a.max == b.max;
+}
+
+// Exact comparison, the loader is expected to be deterministic whatever the thread count
+bool same_mesh(const MeshData& a, const MeshData& b) {
+    if (!same_bbox(a.bbox, b.bbox) || a.parts.size() != b.parts.size() || a.materials.size() != b.materials.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.materials.size(); i++) {
+        const auto& first = a.materials[i];
+        const auto& second = b.materials[i];
+        if (first.texture_path != second.texture_path || first.diffuse_color != second.diffuse_color || first.opacity != second.opacity) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.parts.size(); i++) {
+        const auto& first = a.parts[i];
+        const auto& second = b.parts[i];
+        if (first.material_index != second.material_index || first.vertices != second.vertices || first.elements != second.elements
+            || first.texture_coords != second.texture_coords || first.lod_elements != second.lod_elements) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t count_triangles(const MeshData& mesh) {
+    size_t count = 0;
+    for (const auto& part : mesh.parts) {
+        count += part.elements.size() / 3;
+    }
+    return count;
+}
+
+// Seconds for num_steps steps of num_entities entities moving forward
+double time_entity_store(size_t num_entities, unsigned num_steps) {
+    EntityStore store;
+    store.reserve(num_entities);
+
+    const ModelInstance model(nullptr);
+    for (size_t i = 0; i < num_entities; i++) {
+        store.spawn(model, glm::normalize(random_point(1.0f) + glm::vec3(0.0f, 0.0f, 2.0f)), 0);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned step = 0; step < num_steps; step++) {
+        store.integrate(1.0f);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double time_asteroid_list(size_t num_entities, unsigned num_steps) {
+    std::list<Asteroid> asteroids;
+
+    const ModelInstance model(nullptr);
+    for (size_t i = 0; i < num_entities; i++) {
+        asteroids.emplace_back(model, glm::normalize(random_point(1.0f) + glm::vec3(0.0f, 0.0f, 2.0f)));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned step = 0; step < num_steps; step++) {
+        for (auto& asteroid : asteroids) {
+            asteroid.moveAuto(1.0f);
+            if (asteroid.dead) asteroid.die();
+        }
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double per_tick_us(double total_ms, uint64_t ticks) {
+    return 1000.0 * total_ms / ticks;
+}
+
+} // namespace
+
+int run_headless(uint64_t num_ticks, unsigned seed) {
+    if (num_ticks == 0) {
+        std::cerr << "Headless run needs a positive number of ticks" << std::endl;
+        return -1;
+    }
+
+    srand(seed);
+
+    std::cout << "Loading models... ";
+    const auto load_start = std::chrono::steady_clock::now();
+
+    const ModelFactory model_factory(AssetMode::HEADLESS);
+
+    const auto& load_stats = model_factory.load_stats();
+    std::cout << "\x1b[32mDone\x1b[0m"
+              << " (" << int(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count()) << " ms:"
+              << " cached " << load_stats.cache_hits << "/" << load_stats.cache_hits + load_stats.cache_misses << ")" << std::endl;
+
+    Simulation simulation(model_factory);
+    Camera camera;
+    FrustumCuller culler;
+
+    size_t peak_entities = 0;
+    double cull_ms = 0.0;
+    uint64_t lod_counts[MeshData::max_lods] = {};
+    uint64_t lod_switches = 0;
+
+    // Levels chosen last tick by entity, kept here rather than in the store's lod column, which the renderer owns
+    std::unordered_map<EntityStore::Handle, uint8_t> lods, next_lods;
+    std::vector<uint8_t> tick_lods;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t tick = 0; tick < num_ticks; tick++) {
+        simulation.tick(scripted_input(simulation, camera, tick));
+        simulation.explosions.clear();
+        peak_entities = std::max(peak_entities, simulation.entities.size());
+
+        // What the renderer would cull and which levels it would draw this tick, without interpolation
+        const auto cull_start = std::chrono::steady_clock::now();
+        const auto& entities = simulation.entities;
+        camera.position = simulation.camera_position;
+        const auto eye = glm::vec3(glm::inverse(camera.getViewTransform())[3]);
+        culler.clear();
+        next_lods.clear();
+        tick_lods.resize(entities.size());
+        for (size_t i = 0; i < entities.size(); i++) {
+            const auto bbox = entities.bbox(i);
+            culler.add(bbox);
+
+            const auto previous = lods.find(entities.handle[i]);
+            const int current = previous != lods.end() ? previous->second : 0;
+            tick_lods[i] = uint8_t(entities.asset[i]->selectLod(projected_size(bbox, eye, focal_length), current));
+            if (tick_lods[i] != current) lod_switches++;
+            next_lods[entities.handle[i]] = tick_lods[i];
+        }
+        lods.swap(next_lods);
+        culler.cull(camera.getFrustum(projection));
+        for (size_t i = 0; i < entities.size(); i++) {
+            if (culler.visible(i) && !entities.dying[i]) lod_counts[tick_lods[i]]++;
+        }
+        cull_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cull_start).count();
+    }
+    // Culling and LOD selection are render-side work the game loop does once a frame, not once a tick,
+    // and are reported on their own lines; ticks/s stays comparable with runs that did neither
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() - cull_ms / 1000.0;
+
+    const auto& timings = simulation.timings;
+    std::cout << "Simulated " << num_ticks << " ticks in " << int(1000.0 * seconds) << " ms: "
+              << int(num_ticks / seconds) << " ticks/s"
+              << " (" << int(num_ticks / simulation.tick_seconds) << " inside tick)" << std::endl;
+    std::cout << "Per tick:"
+              << " laser " << per_tick_us(timings.laser_ms, num_ticks) << " us"
+              << ", integrate " << per_tick_us(timings.integrate_ms, num_ticks) << " us"
+              << ", entities " << per_tick_us(timings.entities_ms, num_ticks) << " us"
+              << ", spawn " << per_tick_us(timings.spawn_ms, num_ticks) << " us"
+              << ", broadphase " << per_tick_us(timings.broadphase_ms, num_ticks) << " us"
+              << ", collide " << per_tick_us(timings.collide_ms, num_ticks) << " us" << std::endl;
+    std::cout << "Entities: " << simulation.entities.size() << " alive, " << peak_entities << " peak, "
+              << simulation.spawn_count << " spawned" << std::endl;
+    const auto& cull_stats = culler.totalStats();
+    std::cout << "Culling: " << double(cull_stats.tested) / num_ticks << " entities tested, "
+              << double(cull_stats.culled) / num_ticks << " culled per tick"
+              << " (" << per_tick_us(cull_ms, num_ticks) << " us with LOD selection)" << std::endl;
+    std::cout << "Visible per level of detail:";
+    for (const auto count : lod_counts) {
+        std::cout << " " << double(count) / num_ticks;
+    }
+    std::cout << " per tick, " << lod_switches << " switches" << std::endl;
+    std::cout << "Score: " << simulation.score << ", health: " << int(simulation.main_ship_hp) << std::endl;
+
+    return 0;
+}
+
+int run_particle_benchmark(size_t num_particles, unsigned num_frames) {
+    if (num_particles == 0 || num_frames == 0) {
+        std::cerr << "Particle benchmark needs a positive number of particles and frames" << std::endl;
+        return -1;
+    }
+
+    const auto num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    const auto updates = double(num_particles) * num_frames;
+
+    std::cout << "Updating " << num_particles << " particles for " << num_frames << " frames"
+              << " with the " << CpuParticlePool::kernelName() << " kernel" << std::endl;
+
+    for (const auto threads : {1u, num_threads}) {
+        const auto seconds = time_particle_updates(num_particles, num_frames, threads);
+        std::cout << threads << (threads == 1 ? " thread: " : " threads: ")
+                  << int(updates / seconds / 1e6) << "M particles/s, "
+                  << int(updates / seconds / threads / 1e6) << "M per core, "
+                  << 1000.0 * seconds / num_frames << " ms per frame" << std::endl;
+    }
+
+    // Live particles are compacted and gathered for upload after every update
+    CpuParticlePool pool(num_particles, num_threads);
+    pool.emit({glm::vec3(0.0f), glm::vec3(0.0f), 10.0f, 1e6f, uint32_t(num_particles)});
+    const auto start = std::chrono::steady_clock::now();
+    pool.update(1.0f / 60.0f);
+    std::cout << "Update with compaction: "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+
+    return 0;
+}
+
+int run_entity_benchmark(unsigned num_steps) {
+    if (num_steps == 0) {
+        std::cerr << "Entity benchmark needs a positive number of steps" << std::endl;
+        return -1;
+    }
+
+    srand(0);
+
+    std::cout << "Stepping entities " << num_steps << " times" << std::endl;
+    for (const size_t num_entities : {1000u, 10000u, 100000u}) {
+        const auto updates = double(num_entities) * num_steps;
+        const auto store_seconds = time_entity_store(num_entities, num_steps);
+        const auto list_seconds = time_asteroid_list(num_entities, num_steps);
+
+        std::cout << num_entities << " entities: store " << 1e9 * store_seconds / updates << " ns"
+                  << ", list " << 1e9 * list_seconds / updates << " ns per entity step"
+                  << " (" << list_seconds / store_seconds << "x)" << std::endl;
+    }
+
+    return 0;
+}
+
+int run_collision_benchmark(size_t num_entities, unsigned num_frames) {
+    if (num_entities == 0 || num_frames == 0) {
+        std::cerr << "Collision benchmark needs a positive number of entities and frames" << std::endl;
+        return -1;
+    }
+
+    srand(0);
+
+    // Roughly the scene of the game: entities a few units across in a box a kilometre wide
+    const float extent = 500.0f;
+    const auto ship = CollisionWorld::Id(num_entities);
+
+    std::vector<glm::vec3> positions(num_entities), velocities(num_entities);
+    std::vector<float> sizes(num_entities);
+    std::vector<CollisionLayer> layers(num_entities);
+
+    CollisionWorld world(32.0f);
+    world.insert(ship, unsigned(CollisionLayer::SHIP), box_around(glm::vec3(0.0f), 5.0f));
+    for (size_t i = 0; i < num_entities; i++) {
+        positions[i] = random_point(extent);
+        velocities[i] = random_point(1.0f);
+        sizes[i] = 1.0f + 4.0f * random_unit();
+        layers[i] = static_cast<CollisionLayer>(1 + i % 3);
+        world.insert(CollisionWorld::Id(i), unsigned(layers[i]), box_around(positions[i], sizes[i]));
+    }
+
+    std::cout << "Moving " << num_entities << " entities for " << num_frames << " frames" << std::endl;
+
+    double update_ms = 0.0, ship_ms = 0.0, rockets_ms = 0.0;
+    size_t ship_pairs = 0, rocket_pairs = 0;
+    for (unsigned frame = 0; frame < num_frames; frame++) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < num_entities; i++) {
+            positions[i] += velocities[i];
+            world.update(CollisionWorld::Id(i), box_around(positions[i], sizes[i]));
+        }
+        auto end = std::chrono::steady_clock::now();
+        update_ms += std::chrono::duration<double, std::milli>(end - start).count();
+
+        start = end;
+        for (const auto layer : {CollisionLayer::ENEMY, CollisionLayer::ASTEROID, CollisionLayer::ROCKET}) {
+            world.queryPairs(unsigned(CollisionLayer::SHIP), unsigned(layer), [&](CollisionWorld::Id, CollisionWorld::Id) {
+                ship_pairs++;
+            });
+        }
+        end = std::chrono::steady_clock::now();
+        ship_ms += std::chrono::duration<double, std::milli>(end - start).count();
+
+        start = end;
+        world.queryPairs(unsigned(CollisionLayer::ROCKET), unsigned(CollisionLayer::ENEMY), [&](CollisionWorld::Id, CollisionWorld::Id) {
+            rocket_pairs++;
+        });
+        rockets_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::cout << "Per frame: update " << per_tick_us(update_ms, num_frames) << " us"
+              << ", ship query " << per_tick_us(ship_ms, num_frames) << " us"
+              << ", rockets against enemies " << per_tick_us(rockets_ms, num_frames) << " us" << std::endl;
+    std::cout << "Pairs: " << ship_pairs << " with the ship, " << rocket_pairs << " rocket-enemy" << std::endl;
+
+    // Brute force over the final positions, for small scenes only
+    if (num_entities > 20000) return 0;
+
+    size_t grid_pairs = 0, brute_pairs = 0;
+    world.queryPairs(unsigned(CollisionLayer::ROCKET), unsigned(CollisionLayer::ENEMY), [&](CollisionWorld::Id, CollisionWorld::Id) {
+        grid_pairs++;
+    });
+    for (size_t a = 0; a < num_entities; a++) {
+        if (layers[a] != CollisionLayer::ROCKET) continue;
+        for (size_t b = 0; b < num_entities; b++) {
+            if (layers[b] == CollisionLayer::ENEMY && intersect(box_around(positions[a], sizes[a]), box_around(positions[b], sizes[b]))) {
+                brute_pairs++;
+            }
+        }
+    }
+    std::cout << "Last frame: " << grid_pairs << " rocket-enemy pairs, brute force " << brute_pairs << std::endl;
+    return grid_pairs == brute_pairs ? 0 : 1;
+}
+
+int run_picking_benchmark(size_t num_targets, unsigned num_rays) {
+    if (num_targets == 0 || num_rays == 0) {
+        std::cerr << "Picking benchmark needs a positive number of targets and rays" << std::endl;
+        return -1;
+    }
+
+    srand(0);
+
+    const float extent = 500.0f;
+    std::vector<BBox> boxes(num_targets);
+    DynamicBVH tree;
+    for (size_t i = 0; i < num_targets; i++) {
+        boxes[i] = box_around(random_point(extent), 1.0f + 4.0f * random_unit());
+        tree.insert(DynamicBVH::Id(i), boxes[i]);
+    }
+
+    // From around the camera towards random points of the scene, so most rays hit something far away
+    std::vector<Ray> rays(num_rays);
+    for (auto& ray : rays) {
+        ray.origin = glm::vec3(0.0f, 0.0f, extent) + random_point(10.0f);
+        ray.direction = random_point(extent) - ray.origin;
+    }
+
+    // Leaves hold inflated boxes, the exact box is tested the way the game tests triangles
+    const auto refine = [&](DynamicBVH::Id id, const Ray& ray, float& t) {
+        return intersect(boxes[id], ray.origin, 1.0f / ray.direction, t);
+    };
+
+    std::vector<DynamicBVH::Id> tree_hits(num_rays, DynamicBVH::Id(-1));
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned r = 0; r < num_rays; r++) {
+        float t;
+        tree.raycast(rays[r], refine, tree_hits[r], t);
+    }
+    const auto tree_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<DynamicBVH::Id> linear_hits(num_rays, DynamicBVH::Id(-1));
+    start = std::chrono::steady_clock::now();
+    for (unsigned r = 0; r < num_rays; r++) {
+        const auto dir_inverse = 1.0f / rays[r].direction;
+        float best_t = INFINITY;
+        for (size_t i = 0; i < num_targets; i++) {
+            float t;
+            if (intersect(boxes[i], rays[r].origin, dir_inverse, t) && t < best_t) {
+                best_t = t;
+                linear_hits[r] = DynamicBVH::Id(i);
+            }
+        }
+    }
+    const auto linear_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t hits = 0, mismatches = 0;
+    for (unsigned r = 0; r < num_rays; r++) {
+        if (linear_hits[r] != DynamicBVH::Id(-1)) hits++;
+        if (tree_hits[r] != linear_hits[r]) mismatches++;
+    }
+
+    std::cout << "Casting " << num_rays << " rays at " << num_targets << " targets, " << hits << " hit" << std::endl;
+    std::cout << "Per ray: tree " << per_tick_us(tree_ms, num_rays) << " us, every box " << per_tick_us(linear_ms, num_rays) << " us" << std::endl;
+    std::cout << "Nearest hits differing: " << mismatches << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+int run_loader_check() {
+    const auto num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::map<ModelName, MeshData> meshes[2];
+    std::map<ModelName, BBox> bboxes[2];
+    const unsigned threads[2] = {1u, num_threads};
+    bool cached = false;
+    for (int run = 0; run < 2; run++) {
+        const auto start = std::chrono::steady_clock::now();
+        const ModelFactory model_factory(AssetMode::HEADLESS_IMPORT, threads[run], &meshes[run]);
+        const auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        for (const auto& item : meshes[run]) {
+            bboxes[run][item.first] = model_factory.get_asset(item.first)->bbox;
+        }
+
+        const auto& load_stats = model_factory.load_stats();
+        std::cout << threads[run] << (threads[run] == 1 ? " thread: " : " threads: ") << int(ms) << " ms,"
+                  << " cached " << load_stats.cache_hits << "/" << load_stats.cache_hits + load_stats.cache_misses << std::endl;
+        cached = cached || load_stats.cache_hits != 0;
+    }
+
+    // A model read from the mesh cache would compare the cache with itself, not the importer
+    if (cached) {
+        std::cerr << "Loader check: models were read from the mesh cache instead of imported" << std::endl;
+        return 1;
+    }
+
+    int mismatches = 0;
+    for (const auto& item : meshes[0]) {
+        const auto other = meshes[1].find(item.first);
+        const auto same = other != meshes[1].end() && same_mesh(item.second, other->second)
+                          && same_bbox(bboxes[0][item.first], bboxes[1][item.first]);
+        if (!same) mismatches++;
+
+        std::cout << model_names[item.first] << ": " << item.second.parts.size() << " parts, "
+                  << count_triangles(item.second) << " triangles "
+                  << (same ? "\x1b[32mmatch\x1b[0m" : "\x1b[31mdiffer\x1b[0m") << std::endl;
+    }
+    if (meshes[0].size() != meshes[1].size()) mismatches++;
+
+    std::cout << "Loader check: " << mismatches << " mismatched models" << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+int run_vertex_report() {
+    std::map<ModelName, MeshData> meshes;
+    const ModelFactory model_factory(AssetMode::HEADLESS, std::max(std::thread::hardware_concurrency(), 1u), &meshes);
+
+    // Three float coordinates and two float texture coordinates per vertex, every index 32-bit
+    const size_t float_vertex_size = 5 * sizeof(GLfloat);
+
+    size_t total_float = 0, total_packed = 0;
+    for (const auto& item : meshes) {
+        size_t num_vertices = 0, num_elements = 0, float_bytes = 0, packed_bytes = 0;
+        double cache_misses = 0.0;
+        for (const auto& part : item.second.parts) {
+            cache_misses += vertex_cache_acmr(part.elements) * (part.elements.size() / 3);
+            size_t part_elements = part.elements.size();
+            for (const auto& lod : part.lod_elements) {
+                part_elements += lod.size();
+            }
+            num_vertices += part.vertices.size() / 3;
+            num_elements += part_elements;
+            float_bytes += part.vertices.size() / 3 * float_vertex_size + part_elements * sizeof(GLuint);
+            packed_bytes += Object::bufferBytes(part);
+        }
+        total_float += float_bytes;
+        total_packed += packed_bytes;
+
+        std::cout << model_names[item.first] << ": " << num_vertices << " vertices, " << num_elements << " indices, "
+                  << float_bytes / 1024 << " KB -> " << packed_bytes / 1024 << " KB, "
+                  << "ACMR " << std::fixed << std::setprecision(2) << cache_misses / std::max(count_triangles(item.second), size_t(1))
+                  << std::defaultfloat << std::endl;
+    }
+
+    std::cout << "Vertex and index buffers: " << total_float / 1024 << " KB -> " << total_packed / 1024 << " KB ("
+              << Object::vertexLayout().getStride() << " bytes per vertex against " << float_vertex_size << ")" << std::endl;
+    return 0;
+}
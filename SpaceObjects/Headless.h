@@ -0,0 +1,40 @@
+#ifndef SPACEOBJECTS_HEADLESS_H
+#define SPACEOBJECTS_HEADLESS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Runs num_ticks of game logic as fast as possible, without a window or GL context.
+// Input comes from a fixed script and rand() is seeded with seed, so runs are repeatable.
+// Prints throughput and per-stage timings, returns the process exit code
+int run_headless(uint64_t num_ticks, unsigned seed);
+
+// Updates num_particles CPU particles for num_frames frames, first on one thread, then on all of them.
+// Prints particles updated per second per core, returns the process exit code
+int run_particle_benchmark(size_t num_particles, unsigned num_frames);
+
+// Steps 1k, 10k and 100k entities num_steps times, through EntityStore::integrate and through a
+// std::list<Asteroid> loop as the game did before the store. Prints nanoseconds per entity step
+int run_entity_benchmark(unsigned num_steps);
+
+// Moves num_entities boxes through a collision world for num_frames frames and queries it the way
+// the game does, ship against every layer, plus rockets against enemies. Prints microseconds per frame
+// for updates and queries and checks the last frame's pairs against brute force, returns the process exit code
+int run_collision_benchmark(size_t num_entities, unsigned num_frames);
+
+// Casts num_rays random rays into num_targets boxes, through DynamicBVH and by testing every box.
+// Prints microseconds per ray for both and how many nearest hits differ, returns the process exit code
+int run_picking_benchmark(size_t num_targets, unsigned num_rays);
+
+// Imports every model headless on one thread and then on all of them, bypassing the mesh cache, and
+// compares the parsed meshes and bounding boxes. Returns the process exit code, non-zero if any model
+// differs or was read from the cache
+int run_loader_check();
+
+// Loads every model headless and prints the GPU buffer bytes of each, with the separate float position
+// and texture coordinate buffers and 32-bit indices used before and with the interleaved quantized layout.
+// Also prints the post-transform cache ACMR of the full detail level; as imported, faces share no
+// vertices and every model starts at 3, the import report shows both figures on a cache miss
+int run_vertex_report();
+
+#endif //SPACEOBJECTS_HEADLESS_H
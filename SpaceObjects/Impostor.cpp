@@ -0,0 +1,179 @@
+#include "Impostor.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <utility>
+#include <glm/gtc/matrix_transform.hpp>
+
+constexpr int ImpostorAtlas::cell_size;
+constexpr int ImpostorAtlas::columns;
+constexpr int ImpostorAtlas::gutter;
+constexpr int ImpostorAtlas::max_level;
+
+ImpostorAtlas::ImpostorAtlas(const ShaderProgram& program, const MeshUniforms& uniforms, const std::vector<const MeshAsset*>& assets) {
+    // Eight around the equator and at 45 degrees above and below it, plus the poles
+    for (int elevation = -1; elevation <= 1; elevation++) {
+        for (int azimuth = 0; azimuth < 8; azimuth++) {
+            const auto theta = elevation * glm::radians(45.0f);
+            const auto phi = azimuth * glm::radians(45.0f);
+            directions.emplace_back(std::cos(theta) * std::sin(phi), std::sin(theta), std::cos(theta) * std::cos(phi));
+            ups.emplace_back(0.0f, 1.0f, 0.0f);
+        }
+    }
+    directions.emplace_back(0.0f, 1.0f, 0.0f);
+    ups.emplace_back(0.0f, 0.0f, -1.0f);
+    directions.emplace_back(0.0f, -1.0f, 0.0f);
+    ups.emplace_back(0.0f, 0.0f, 1.0f);
+
+    const auto num_cells = int(assets.size() * directions.size());
+    rows = std::max((num_cells + columns - 1) / columns, 1);
+    const auto width = columns * cell_size;
+    const auto height = rows * cell_size;
+
+    glGenTextures(1, &texture);
+    gl_state().bindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, max_level);
+    GL_CHECK_ERRORS;
+
+    GLuint framebuffer, depth_buffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+    glGenRenderbuffers(1, &depth_buffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Impostor framebuffer is incomplete, distant asteroids will be invisible" << std::endl;
+    } else {
+        GLint viewport[4];
+        GLfloat clear_color[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+
+        // Transparent black where no mesh covers the picture. Meshes are opaque, so the atlas and
+        // its mips hold premultiplied colors
+        glViewport(0, 0, width, height);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        gl_state().depthMask(true);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        gl_state().setEnabled(GL_DEPTH_TEST, true);
+        gl_state().setEnabled(GL_BLEND, false);
+
+        program.StartUseShader();
+        for (size_t i = 0; i < assets.size(); i++) {
+            first_cell[assets[i]] = int(i * directions.size());
+            capture(program, uniforms, *assets[i], first_cell[assets[i]]);
+        }
+
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(1, &depth_buffer);
+    glDeleteFramebuffers(1, &framebuffer);
+
+    gl_state().bindTexture(GL_TEXTURE_2D, texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    GL_CHECK_ERRORS;
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &instance_buffer);
+
+    gl_state().bindVertexArray(VAO);
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+
+    const std::pair<GLuint, size_t> attributes[] = {
+        {0, offsetof(ImpostorInstance, center)}, // center, radius
+        {1, offsetof(ImpostorInstance, up)},     // up, opacity
+        {2, offsetof(ImpostorInstance, cell)},
+    };
+    for (const auto& attribute : attributes) {
+        glEnableVertexAttribArray(attribute.first);
+        glVertexAttribPointer(attribute.first, 4, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance), reinterpret_cast<const void*>(attribute.second));
+        glVertexAttribDivisor(attribute.first, 1);
+    }
+
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, 0);
+    gl_state().bindVertexArray(0);
+}
+
+void ImpostorAtlas::capture(const ShaderProgram& program, const MeshUniforms& uniforms, const MeshAsset& asset, int first) {
+    const auto center = 0.5f * (asset.bbox.min + asset.bbox.max);
+    const auto radius = 0.5f * glm::length(asset.bbox.max - asset.bbox.min);
+    const auto projection = glm::ortho(-radius, radius, -radius, radius, radius, 3.0f * radius);
+
+    asset.uploadInstances(0, {InstanceData{glm::mat4(1.0f), 1.0f, 0.0f}});
+
+    for (size_t d = 0; d < directions.size(); d++) {
+        const auto cell = first + int(d);
+        glViewport((cell % columns) * cell_size + gutter, (cell / columns) * cell_size + gutter, cell_size - 2 * gutter, cell_size - 2 * gutter);
+
+        const auto view = glm::lookAt(center + 2.0f * radius * directions[d], center, ups[d]);
+        program.SetUniform(uniforms.view_projection, projection * view);
+
+        for (const auto& object : asset.objects) {
+            program.SetUniform(uniforms.diffuse_color, object.getDiffuseColor());
+            program.SetUniform(uniforms.use_texture, object.haveTexture());
+            program.SetUniform(uniforms.texture_layer, float(object.getTextureLayer()));
+            program.SetUniform(uniforms.opacity, object.getOpacity());
+            program.SetUniform(uniforms.position_offset, object.getPositionOffset());
+            program.SetUniform(uniforms.position_scale, object.getPositionScale());
+
+            gl_state().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D_ARRAY, object.getTexture());
+            gl_state().bindVertexArray(object.getVertexArray());
+            glDrawElementsInstanced(GL_TRIANGLES, object.getNumElements(), object.getIndexType(), nullptr, 1);
+        }
+    }
+    GL_CHECK_ERRORS;
+}
+
+void ImpostorAtlas::add(const MeshAsset* asset, const glm::mat4& transform, float scale, const glm::vec3& eye, float opacity) {
+    const auto first = first_cell.find(asset);
+    if (first == first_cell.end()) return;
+
+    const auto& bbox = asset->bbox;
+    const glm::vec3 center = transform * glm::vec4(0.5f * (bbox.min + bbox.max), 1.0f);
+    const auto radius = 0.5f * scale * glm::length(bbox.max - bbox.min);
+
+    // The inverse of a rotation is its transpose
+    const auto rotation = glm::mat3(transform) * (1.0f / scale);
+    const auto to_eye = glm::transpose(rotation) * glm::normalize(eye - center);
+
+    size_t best = 0;
+    for (size_t d = 1; d < directions.size(); d++) {
+        if (glm::dot(directions[d], to_eye) > glm::dot(directions[best], to_eye)) best = d;
+    }
+
+    const auto cell = first->second + int(best);
+    const auto width = float(columns * cell_size);
+    const auto height = float(rows * cell_size);
+    const glm::vec4 cell_rect(((cell % columns) * cell_size + gutter) / width, ((cell / columns) * cell_size + gutter) / height,
+                              (cell_size - 2 * gutter) / width, (cell_size - 2 * gutter) / height);
+    instances.push_back({center, radius, rotation * ups[best], opacity, cell_rect});
+}
+
+void ImpostorAtlas::draw() {
+    if (instances.empty()) return;
+
+    gl_state().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, texture);
+    gl_state().bindVertexArray(VAO);
+
+    // Respecified every frame, like the mesh instance buffers
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(ImpostorInstance), instances.data(), GL_STREAM_DRAW);
+
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(instances.size()));
+}
@@ -0,0 +1,79 @@
+#ifndef SPACEOBJECTS_IMPOSTOR_H
+#define SPACEOBJECTS_IMPOSTOR_H
+
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "InstancedRenderer.h"
+#include "MeshAsset.h"
+#include "ShaderProgram.h"
+
+// Per-instance attributes of an impostor quad, locations 0-2
+struct ImpostorInstance {
+    glm::vec3 center;
+    float radius;
+    glm::vec3 up;   // world direction of the picture's up axis
+    float opacity;
+    glm::vec4 cell; // origin and size of the picture in the atlas, in texture coordinates
+};
+
+// Pictures of meshes taken at load time from a fixed set of directions around them, drawn as
+// camera-facing quads in place of distant instances. Each instance shows the picture taken
+// from the direction closest to the one it is seen from, all of them in one instanced draw
+class ImpostorAtlas {
+public:
+    static constexpr int cell_size = 128;
+    static constexpr int columns = 8;
+    // Pictures leave a transparent border in their cell and the mip chain stops at 8x8 cells,
+    // where the border is still half a texel wide, so filtering never reaches into the next cell
+    static constexpr int gutter = 8;
+    static constexpr int max_level = 4;
+
+private:
+    // Model space directions the pictures are taken from, and the up axis of each picture
+    std::vector<glm::vec3> directions;
+    std::vector<glm::vec3> ups;
+
+    std::unordered_map<const MeshAsset*, int> first_cell;
+    int rows;
+
+    GLuint texture;
+    GLuint VAO, instance_buffer;
+    std::vector<ImpostorInstance> instances;
+
+    void capture(const ShaderProgram& program, const MeshUniforms& uniforms, const MeshAsset& asset, int first);
+
+public:
+    // Renders the assets with the mesh program. Leaves depth testing on and blending off
+    ImpostorAtlas(const ShaderProgram& program, const MeshUniforms& uniforms, const std::vector<const MeshAsset*>& assets);
+
+    ImpostorAtlas(const ImpostorAtlas&) = delete;
+    ImpostorAtlas& operator=(const ImpostorAtlas&) = delete;
+
+    bool has(const MeshAsset* asset) const {
+        return first_cell.count(asset) != 0;
+    }
+
+    // An instance of an asset passed to the constructor, world transform without scaling
+    // beyond scale, seen from eye
+    void add(const MeshAsset* asset, const glm::mat4& transform, float scale, const glm::vec3& eye, float opacity);
+
+    // Uploads and draws the instances added since the last clear(), with the impostor program in use
+    void draw();
+
+    void clear() {
+        instances.clear();
+    }
+
+    size_t size() const {
+        return instances.size();
+    }
+
+    GLuint getTexture() const {
+        return texture;
+    }
+};
+
+#endif //SPACEOBJECTS_IMPOSTOR_H
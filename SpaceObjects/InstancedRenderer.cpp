@@ -0,0 +1,82 @@
+#include "InstancedRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+
+void InstancedRenderer::setPartUniforms(const ShaderProgram& program, const void* data) {
+    const auto part = static_cast<const PartDraw*>(data);
+
+    if (!part->batch->uploaded) {
+        part->asset->uploadInstances(part->lod, part->batch->instances);
+        part->batch->uploaded = true;
+    }
+
+    const auto& uniforms = *part->uniforms;
+    program.SetUniform(uniforms.diffuse_color, part->object->getDiffuseColor());
+    program.SetUniform(uniforms.use_texture, part->object->haveTexture());
+    program.SetUniform(uniforms.texture_layer, float(part->object->getTextureLayer()));
+    program.SetUniform(uniforms.opacity, part->object->getOpacity());
+    program.SetUniform(uniforms.position_offset, part->object->getPositionOffset());
+    program.SetUniform(uniforms.position_scale, part->object->getPositionScale());
+}
+
+void InstancedRenderer::submit(RenderQueue& queue, RenderPass pass, const ShaderProgram& program, const MeshUniforms& uniforms, const glm::vec3& eye) {
+    // Packets point into parts, so it must not reallocate while they are added
+    size_t num_parts = 0;
+    for (const auto& levels : batches) {
+        for (const auto& batch : levels.second) {
+            if (!batch.instances.empty()) num_parts += levels.first->objects.size();
+        }
+    }
+    parts.clear();
+    parts.reserve(num_parts);
+
+    for (auto& levels : batches) {
+        const auto asset = levels.first;
+        for (int lod = 0; lod < int(levels.second.size()); lod++) {
+            auto& batch = levels.second[lod];
+            const auto& instances = batch.instances;
+            if (instances.empty()) continue;
+
+            // Nearest and farthest instance, for front to back and back to front passes
+            float nearest = INFINITY, farthest = 0.0f;
+            for (const auto& instance : instances) {
+                const auto distance = glm::length(glm::vec3(instance.transform[3]) - eye);
+                nearest = std::min(nearest, distance);
+                farthest = std::max(farthest, distance);
+            }
+            const auto depth = pass == RenderPass::MESHES ? nearest : farthest;
+
+            for (const auto& object : asset->objects) {
+                parts.push_back({asset, lod, &batch, &object, &uniforms});
+
+                DrawPacket packet;
+                packet.key = RenderQueue::makeKey(pass, program, object.getTexture(), object.getVertexArray(lod), depth);
+                packet.program = &program;
+                packet.set_uniforms = setPartUniforms;
+                packet.uniform_data = &parts.back();
+                packet.texture_target = GL_TEXTURE_2D_ARRAY;
+                packet.texture = object.getTexture();
+                packet.vertex_array = object.getVertexArray(lod);
+                packet.index_type = object.getIndexType();
+                packet.first_element = object.getFirstElement(lod);
+                packet.num_elements = object.getNumElements(lod);
+                packet.instances = GLsizei(instances.size());
+                queue.submit(packet);
+
+                lod_stats.triangles[lod] += object.getNumElements(lod) / 3 * int(instances.size());
+            }
+            lod_stats.instances[lod] += int(instances.size());
+        }
+    }
+}
+
+void InstancedRenderer::clear() {
+    for (auto& levels : batches) {
+        for (auto& batch : levels.second) {
+            batch.instances.clear();
+            batch.uploaded = false;
+        }
+    }
+    lod_stats = LodStats();
+}
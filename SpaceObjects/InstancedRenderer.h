@@ -0,0 +1,86 @@
+#ifndef SPACEOBJECTS_INSTANCEDRENDERER_H
+#define SPACEOBJECTS_INSTANCEDRENDERER_H
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "Model.h"
+#include "RenderQueue.h"
+#include "ShaderProgram.h"
+
+// Uniforms shared by the classic and explosion programs
+struct MeshUniforms {
+    Uniform view_projection;
+    Uniform diffuse_color;
+    Uniform use_texture;
+    Uniform texture_layer;
+    Uniform opacity;
+    Uniform position_offset;
+    Uniform position_scale;
+
+    explicit MeshUniforms(const ShaderProgram& program) :
+        view_projection(program.GetUniform("view_projection")),
+        diffuse_color(program.GetUniform("diffuse_color")),
+        use_texture(program.GetUniform("use_texture")),
+        texture_layer(program.GetUniform("texture_layer")),
+        opacity(program.GetUniform("opacity")),
+        position_offset(program.GetUniform("position_offset")),
+        position_scale(program.GetUniform("position_scale")) {}
+};
+
+// Instances and triangles submitted at each level of detail
+struct LodStats {
+    int instances[MeshData::max_lods] = {};
+    int triangles[MeshData::max_lods] = {};
+};
+
+// Collects instances of the frame grouped by their mesh and level of detail, then submits
+// each mesh part of a group as a single instanced draw. Use one renderer per pass: the instance
+// buffer of a level is filled when the first of its parts is drawn
+class InstancedRenderer {
+    struct Batch {
+        std::vector<InstanceData> instances;
+        bool uploaded = false;
+    };
+
+    // Uniform data of one packet, kept until the queue has executed
+    struct PartDraw {
+        const MeshAsset* asset;
+        int lod;
+        Batch* batch;
+        const Object* object;
+        const MeshUniforms* uniforms;
+    };
+
+    // One batch per level of detail of the asset
+    std::unordered_map<const MeshAsset*, std::vector<Batch>> batches;
+    std::vector<PartDraw> parts;
+    LodStats lod_stats;
+
+    static void setPartUniforms(const ShaderProgram& program, const void* data);
+
+public:
+    void add(const MeshAsset* asset, const glm::mat4& transform, float opacity = 1.0f, float magnitude = 0.0f, int lod = 0) {
+        auto& levels = batches[asset];
+        levels.resize(asset->num_lods);
+        levels[std::min(lod, asset->num_lods - 1)].instances.push_back({transform, opacity, magnitude});
+    }
+
+    void add(const ModelInstance& model, float opacity = 1.0f, float magnitude = 0.0f) {
+        add(model.asset.get(), model.getWorldTransform(), opacity, magnitude);
+    }
+
+    // The view-projection matrix is left to the caller, as frame uniforms of the program
+    void submit(RenderQueue& queue, RenderPass pass, const ShaderProgram& program, const MeshUniforms& uniforms, const glm::vec3& eye);
+
+    // Empties all batches, keeping their storage. Call once the queue has executed
+    void clear();
+
+    // Of the submits since the last clear()
+    const LodStats& lodStats() const {
+        return lod_stats;
+    }
+};
+
+#endif //SPACEOBJECTS_INSTANCEDRENDERER_H
@@ -1,17 +1,21 @@
 #ifndef SPACEOBJECTS_MATERIAL_H
 #define SPACEOBJECTS_MATERIAL_H
 
+#include <utility>
 #include <vector>
+#include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "TextureRegistry.h"
+
 class Material {
 public:
-    GLuint diffuse_texture;
+    TextureHandle diffuse_texture; // null if the material has none
     glm::vec4 diffuse_color;
     float opacity;
 
-    explicit Material(GLuint diffuse_texture, const glm::vec4& diffuse_color = glm::vec4(1.0f), float opacity=1.0) :
-        diffuse_texture(diffuse_texture),
+    explicit Material(TextureHandle diffuse_texture, const glm::vec4& diffuse_color = glm::vec4(1.0f), float opacity=1.0) :
+        diffuse_texture(std::move(diffuse_texture)),
         diffuse_color(diffuse_color),
         opacity(opacity) {}
 };
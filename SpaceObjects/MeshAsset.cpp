@@ -0,0 +1,299 @@
+#include "MeshAsset.h"
+#include "GLState.h"
+#include "MeshCache.h"
+#include "MeshOptimize.h"
+#include "MeshSimplify.h"
+#include "TextureCache.h"
+#include "common.h"
+
+#include <algorithm>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <unordered_set>
+#include <il.h>
+
+namespace {
+
+double elapsed_ms(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+void process_object(const aiNode* node, const aiScene* scene, MeshData& data) {
+    for (int i = 0; i < node->mNumMeshes; i++) {
+        const auto mesh = scene->mMeshes[node->mMeshes[i]];
+
+        MeshPart part;
+        part.material_index = mesh->mMaterialIndex;
+
+        // Vertices
+        for (int j = 0; j < mesh->mNumVertices; j++) {
+            const auto& vertex = mesh->mVertices[j];
+
+            part.vertices.push_back(vertex.x);
+            part.vertices.push_back(vertex.y);
+            part.vertices.push_back(vertex.z);
+
+            // Texture coordinates
+            part.texture_coords.push_back(mesh->mTextureCoords[0][j].x);
+            part.texture_coords.push_back(mesh->mTextureCoords[0][j].y);
+        }
+
+        // Indices
+        for (int j = 0; j < mesh->mNumFaces; j++) {
+            const auto& face = mesh->mFaces[j];
+
+            for (int k = 0; k < face.mNumIndices; k++) {
+                part.elements.push_back(face.mIndices[k]);
+            }
+        }
+
+        data.parts.push_back(std::move(part));
+    }
+
+    for (int i = 0; i < node->mNumChildren; i++) {
+        process_object(node->mChildren[i], scene, data);
+    }
+}
+
+void process_materials(const aiScene* scene, const std::string& model_location, MeshData& data) {
+    for (int material_index = 0; material_index < scene->mNumMaterials; material_index++) {
+        const auto material = scene->mMaterials[material_index];
+        const auto num_textures = material->GetTextureCount(aiTextureType_DIFFUSE);
+
+        aiColor3D diffuse_color;
+        float opacity;
+        material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse_color);
+        material->Get(AI_MATKEY_OPACITY, opacity);
+        const auto glm_diffuse_color = glm::vec4(diffuse_color.r, diffuse_color.g, diffuse_color.b, 1.0f);
+
+        std::string texture_path;
+        if (num_textures != 0) {
+            aiString path;
+            material->GetTexture(aiTextureType_DIFFUSE, 0, &path);
+
+            texture_path = model_location + '/' + path.C_Str();
+        }
+        data.materials.push_back({texture_path, glm_diffuse_color, opacity});
+    }
+}
+
+MeshData import_model(const std::string& path) {
+    MeshData data;
+
+    Assimp::Importer importer;
+
+    const auto scene = importer.ReadFile(path.c_str(), aiProcess_Triangulate | aiProcess_FlipUVs);
+    if (scene == nullptr || scene->mRootNode == nullptr) {
+        std::cerr << "Couldn't read model" << std::endl;
+        return data;
+    }
+
+    process_materials(scene, path.substr(0, path.find_last_of('/')), data);
+
+    process_object(scene->mRootNode, scene, data);
+
+    // Calculate bbox
+    for (const auto& part : data.parts) {
+        for (int i = 0; i < part.vertices.size(); i += 3) {
+            const auto v = part.vertices.data() + i;
+            const glm::vec3 vertex(v[0], v[1], v[2]);
+
+            data.bbox.min = glm::min(data.bbox.min, vertex);
+            data.bbox.max = glm::max(data.bbox.max, vertex);
+        }
+    }
+
+    // Faces come with vertices of their own and in file order; measured before welding
+    std::vector<float> imported_acmr;
+    std::vector<size_t> imported_vertices;
+    for (auto& part : data.parts) {
+        imported_acmr.push_back(vertex_cache_acmr(part.elements));
+        imported_vertices.push_back(part.vertices.size() / 3);
+        weld_vertices(part);
+    }
+
+    // Simplified once here and kept in the mesh cache
+    generate_lods(data);
+
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(2) << "Optimized " << path << '\n';
+    for (size_t i = 0; i < data.parts.size(); i++) {
+        auto& part = data.parts[i];
+        part.elements = optimize_vertex_cache(part.vertices, part.elements);
+        for (auto& elements : part.lod_elements) {
+            elements = optimize_vertex_cache(part.vertices, elements);
+        }
+        optimize_vertex_fetch(part);
+
+        report << "  part " << i << ": " << part.elements.size() / 3 << " triangles, "
+               << imported_vertices[i] << " -> " << part.vertices.size() / 3 << " vertices, "
+               << "ACMR " << imported_acmr[i] << " -> " << vertex_cache_acmr(part.elements) << '\n';
+    }
+    std::cout << report.str();
+
+    return data;
+}
+
+// DevIL keeps the bound image in global state, so decoding is serialized across loader threads
+std::mutex devil_mutex;
+
+ImageData decode_texture(const std::string& path) {
+    std::lock_guard<std::mutex> lock(devil_mutex);
+
+    ILboolean devil_status;
+    const ILuint image_id = ilGenImage();
+    ilBindImage(image_id);
+
+    ImageData image;
+
+    devil_status = ilLoadImage(path.c_str());
+    if (!devil_status) {
+        std::cerr << "Failed to load image: " << path << std::endl;
+        ilDeleteImage(image_id);
+        return image;
+    }
+
+    // Alpha is kept only where the source has it, so opaque textures compress to BC1
+    const auto source_format = ilGetInteger(IL_IMAGE_FORMAT);
+    const auto has_alpha = source_format == IL_RGBA || source_format == IL_BGRA || source_format == IL_LUMINANCE_ALPHA;
+    devil_status = ilConvertImage(has_alpha ? IL_RGBA : IL_RGB, IL_UNSIGNED_BYTE);
+    if (!devil_status) {
+        std::cerr << "Failed to convert image: " << ilGetError() << std::endl;
+    }
+
+    const auto image_location = ilGetData();
+    image.format = GLenum(ilGetInteger(IL_IMAGE_FORMAT));
+    image.width = ilGetInteger(IL_IMAGE_WIDTH);
+    image.height = ilGetInteger(IL_IMAGE_HEIGHT);
+
+    const auto bytes_per_pixel = image.format == GL_RGBA ? 4 : 3;
+    image.pixels.assign(image_location, image_location + size_t(image.width) * image.height * bytes_per_pixel);
+
+    ilDeleteImage(image_id);
+
+    return image;
+}
+
+} // namespace
+
+LoadStats& LoadStats::operator+=(const LoadStats& other) {
+    cache_hits += other.cache_hits;
+    cache_misses += other.cache_misses;
+    texture_cache_hits += other.texture_cache_hits;
+    texture_cache_misses += other.texture_cache_misses;
+    cache_ms += other.cache_ms;
+    import_ms += other.import_ms;
+    texture_ms += other.texture_ms;
+    upload_ms += other.upload_ms;
+    return *this;
+}
+
+ModelSource MeshAsset::load(const std::string& path, LoadStats* stats, AssetMode mode) {
+    LoadStats local_stats;
+    if (stats == nullptr) {
+        stats = &local_stats;
+    }
+
+    auto stage_start = std::chrono::steady_clock::now();
+
+    const auto use_cache = mode != AssetMode::HEADLESS_IMPORT;
+
+    ModelSource source;
+    if (use_cache && MeshCache::load(path, source.mesh)) {
+        stats->cache_hits++;
+        stats->cache_ms += elapsed_ms(stage_start);
+    } else {
+        source.mesh = import_model(path);
+        if (use_cache && !source.mesh.parts.empty()) {
+            MeshCache::store(path, source.mesh);
+        }
+        stats->cache_misses++;
+        stats->import_ms += elapsed_ms(stage_start);
+    }
+
+    if (mode == AssetMode::HEADLESS || mode == AssetMode::HEADLESS_IMPORT) return source;
+
+    stage_start = std::chrono::steady_clock::now();
+    const auto compress = mode != AssetMode::RENDER_UNCOMPRESSED;
+    std::unordered_set<uint64_t> seen;
+    for (const auto& material : source.mesh.materials) {
+        const auto key = texture_registry().key(material.texture_path);
+        source.texture_keys.push_back(key);
+
+        TextureData texture;
+        if (!key.path.empty() && seen.insert(key.hash).second && !texture_registry().resident(key)) {
+            if (TextureCache::load(material.texture_path, compress, texture)) {
+                stats->texture_cache_hits++;
+            } else {
+                texture = build_texture(decode_texture(material.texture_path), compress);
+                if (!texture.empty()) {
+                    TextureCache::store(material.texture_path, texture);
+                }
+                stats->texture_cache_misses++;
+            }
+        }
+        source.textures.push_back(std::move(texture));
+    }
+    stats->texture_ms += elapsed_ms(stage_start);
+
+    return source;
+}
+
+MeshAsset::MeshAsset(const ModelSource& source, LoadStats* stats, AssetMode mode) :
+    bbox(source.mesh.bbox),
+    triangles(source.mesh),
+    num_lods(1) {
+
+    for (const auto& part : source.mesh.parts) {
+        num_lods = std::max(num_lods, 1 + int(part.lod_elements.size()));
+    }
+
+    if (mode == AssetMode::HEADLESS || mode == AssetMode::HEADLESS_IMPORT) return;
+
+    const auto stage_start = std::chrono::steady_clock::now();
+
+    const auto& data = source.mesh;
+    for (int i = 0; i < data.materials.size(); i++) {
+        const auto& material = data.materials[i];
+        materials.emplace_back(texture_registry().acquire(source.texture_keys[i], source.textures[i]), material.diffuse_color, material.opacity);
+    }
+
+    instance_buffers.resize(num_lods);
+    glGenBuffers(num_lods, instance_buffers.data());
+
+    for (const auto& part : data.parts) {
+        objects.emplace_back(part, materials[part.material_index], instance_buffers);
+    }
+
+    if (stats != nullptr) {
+        stats->upload_ms += elapsed_ms(stage_start);
+    }
+}
+
+void MeshAsset::uploadInstances(int lod, const std::vector<InstanceData>& instances) const {
+    // Respecifying the whole store lets the driver orphan the one still used by the previous frame
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, instance_buffers[lod]);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), instances.data(), GL_STREAM_DRAW);
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+int MeshAsset::selectLod(float screen_size, int current) const {
+    // Projected sizes in pixels below which each coarser level takes over
+    const float switch_sizes[MeshData::max_lods - 1] = {160.0f, 60.0f, 20.0f};
+    const float margin = 0.15f;
+
+    auto lod = std::min(current, num_lods - 1);
+    while (lod + 1 < num_lods && screen_size < switch_sizes[lod] * (1.0f - margin)) {
+        lod++;
+    }
+    while (lod > 0 && screen_size > switch_sizes[lod - 1] * (1.0f + margin)) {
+        lod--;
+    }
+    return lod;
+}
@@ -0,0 +1,80 @@
+#ifndef SPACEOBJECTS_MESHASSET_H
+#define SPACEOBJECTS_MESHASSET_H
+
+#include <string>
+#include <vector>
+
+#include "BBox.h"
+#include "Material.h"
+#include "MeshData.h"
+#include "Object.h"
+#include "Picking.h"
+#include "Texture.h"
+#include "TextureRegistry.h"
+
+// Time spent on each stage of model loading
+struct LoadStats {
+    int cache_hits = 0;
+    int cache_misses = 0;
+    int texture_cache_hits = 0;
+    int texture_cache_misses = 0;
+
+    double cache_ms = 0.0;
+    double import_ms = 0.0;
+    double texture_ms = 0.0;
+    double upload_ms = 0.0;
+
+    LoadStats& operator+=(const LoadStats& other);
+};
+
+enum class AssetMode {
+    RENDER,
+    RENDER_UNCOMPRESSED, // for drivers without S3TC, textures keep 3 or 4 bytes per texel
+    HEADLESS, // no GL context: meshes stay on the CPU for collisions and picking, textures are not decoded
+    HEADLESS_IMPORT, // HEADLESS, but every model is imported from its source file, the mesh cache is not used
+};
+
+// Everything a MeshAsset needs before touching GL, so it can be produced off the GL thread
+struct ModelSource {
+    MeshData mesh;
+    // Diffuse texture per material. The data is left empty when there is no texture, or when
+    // the registry or an earlier material of the model already has it
+    std::vector<TextureKey> texture_keys;
+    std::vector<TextureData> textures;
+};
+
+// GPU side of a loaded model. Created once per model file and shared by all of its instances
+class MeshAsset {
+public:
+    std::vector<Object> objects;
+    std::vector<Material> materials;
+
+    BBox bbox;
+
+    // Model-space triangles for exact picking
+    TriangleBVH triangles;
+
+    // Per-frame instance attributes shared by all objects of the asset, one buffer per level of detail
+    std::vector<GLuint> instance_buffers;
+
+    // Levels of detail of the most detailed part, 1 if nothing could be simplified
+    int num_lods;
+
+    // Headless assets have no objects, materials or instance buffers
+    explicit MeshAsset(const ModelSource& source, LoadStats* stats = nullptr, AssetMode mode = AssetMode::RENDER);
+
+    MeshAsset(const MeshAsset&) = delete;
+    MeshAsset& operator=(const MeshAsset&) = delete;
+
+    // Replaces the contents of the instance buffer of a level
+    void uploadInstances(int lod, const std::vector<InstanceData>& instances) const;
+
+    // Level to draw at a projected size in pixels. The current level is kept within a margin
+    // around each switching size, so an instance hovering at one does not flicker between levels
+    int selectLod(float screen_size, int current) const;
+
+    // Parse mesh and build textures, does not need a GL context
+    static ModelSource load(const std::string& path, LoadStats* stats = nullptr, AssetMode mode = AssetMode::RENDER);
+};
+
+#endif //SPACEOBJECTS_MESHASSET_H
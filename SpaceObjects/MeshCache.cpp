@@ -0,0 +1,161 @@
+#include "MeshCache.h"
+#include "CacheFile.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+const char* const MeshCache::suffix = ".meshcache";
+
+namespace {
+
+constexpr uint32_t CACHE_MAGIC = 0x434d4f53; // "SOMC"
+constexpr uint32_t CACHE_VERSION = 3;
+
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t source_hash;
+    uint32_t num_materials;
+    uint32_t num_parts;
+    float bbox_min[3];
+    float bbox_max[3];
+};
+
+bool parse(Reader& reader, const CacheHeader& header, MeshData& data) {
+    data.materials.resize(header.num_materials);
+    for (auto& material : data.materials) {
+        if (!reader.read_string(material.texture_path)
+            || !reader.read(material.diffuse_color)
+            || !reader.read(material.opacity)) {
+            return false;
+        }
+    }
+
+    data.parts.resize(header.num_parts);
+    for (auto& part : data.parts) {
+        if (!reader.read(part.material_index)
+            || !reader.read_array(part.vertices)
+            || !reader.read_array(part.elements)
+            || !reader.read_array(part.texture_coords)) {
+            return false;
+        }
+        if (part.material_index >= data.materials.size()) return false;
+
+        uint32_t num_lods;
+        if (!reader.read(num_lods) || num_lods >= MeshData::max_lods) return false;
+        part.lod_elements.resize(num_lods);
+        for (auto& elements : part.lod_elements) {
+            if (!reader.read_array(elements)) return false;
+        }
+    }
+
+    data.bbox = BBox({header.bbox_min[0], header.bbox_min[1], header.bbox_min[2]},
+                     {header.bbox_max[0], header.bbox_max[1], header.bbox_max[2]});
+
+    return reader.cur == reader.end;
+}
+
+} // namespace
+
+bool MeshCache::load(const std::string& source_path, MeshData& data) {
+    SourceStamp stamp;
+    if (!stat_source(source_path, stamp)) return false;
+
+    const auto cache_path = source_path + suffix;
+    CacheHeader header;
+    {
+        MappedFile file(cache_path);
+        if (file.data() == nullptr) return false;
+
+        Reader reader {file.data(), file.data() + file.size()};
+        if (!reader.read(header)
+            || header.magic != CACHE_MAGIC
+            || header.version != CACHE_VERSION
+            || header.source_size != stamp.size) {
+            return false;
+        }
+
+        if (header.source_mtime != stamp.mtime && header.source_hash != hash_source(source_path)) {
+            return false;
+        }
+
+        if (!parse(reader, header, data)) {
+            std::cerr << "Corrupted mesh cache: " << cache_path << std::endl;
+            data = MeshData();
+            return false;
+        }
+    }
+
+    // Same content under a new mtime, remember it to skip hashing next time
+    if (header.source_mtime != stamp.mtime) {
+        header.source_mtime = stamp.mtime;
+
+        std::fstream file(cache_path, std::ios::binary | std::ios::in | std::ios::out);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+    return true;
+}
+
+bool MeshCache::store(const std::string& source_path, const MeshData& data) {
+    SourceStamp stamp;
+    if (!stat_source(source_path, stamp)) return false;
+
+    CacheHeader header;
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.source_size = stamp.size;
+    header.source_mtime = stamp.mtime;
+    header.source_hash = hash_source(source_path);
+    header.num_materials = uint32_t(data.materials.size());
+    header.num_parts = uint32_t(data.parts.size());
+    for (int i = 0; i < 3; i++) {
+        header.bbox_min[i] = data.bbox.min[i];
+        header.bbox_max[i] = data.bbox.max[i];
+    }
+
+    // Write aside and rename, so a crash never leaves a truncated cache behind
+    const auto cache_path = source_path + suffix;
+    const auto tmp_path = temporary_path(cache_path);
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "Couldn't write mesh cache: " << cache_path << std::endl;
+            return false;
+        }
+
+        Writer writer {out};
+        writer.write(header);
+
+        for (const auto& material : data.materials) {
+            writer.write_string(material.texture_path);
+            writer.write(material.diffuse_color);
+            writer.write(material.opacity);
+        }
+
+        for (const auto& part : data.parts) {
+            writer.write(part.material_index);
+            writer.write_array(part.vertices);
+            writer.write_array(part.elements);
+            writer.write_array(part.texture_coords);
+
+            writer.write(uint32_t(part.lod_elements.size()));
+            for (const auto& elements : part.lod_elements) {
+                writer.write_array(elements);
+            }
+        }
+
+        if (!out.good()) {
+            out.close();
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    std::remove(cache_path.c_str());
+    return std::rename(tmp_path.c_str(), cache_path.c_str()) == 0;
+}
@@ -0,0 +1,20 @@
+#ifndef SPACEOBJECTS_MESHCACHE_H
+#define SPACEOBJECTS_MESHCACHE_H
+
+#include <string>
+
+#include "MeshData.h"
+
+// Binary on-disk copy of imported models, stored next to the source file.
+// A cache entry is valid while the source file keeps its size and either its
+// modification time or its content hash (copying the models directory resets mtime).
+class MeshCache {
+public:
+    static const char* const suffix;
+
+    static bool load(const std::string& source_path, MeshData& data);
+
+    static bool store(const std::string& source_path, const MeshData& data);
+};
+
+#endif //SPACEOBJECTS_MESHCACHE_H
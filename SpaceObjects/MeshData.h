@@ -0,0 +1,43 @@
+#ifndef SPACEOBJECTS_MESHDATA_H
+#define SPACEOBJECTS_MESHDATA_H
+
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "BBox.h"
+
+// CPU-side description of a model, independent of any GL state
+
+struct MaterialData {
+    std::string texture_path; // empty if material has no diffuse texture
+    glm::vec4 diffuse_color;
+    float opacity;
+};
+
+struct MeshPart {
+    GLuint material_index;
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> elements;
+    std::vector<GLfloat> texture_coords;
+    std::vector<std::vector<GLuint>> lod_elements; // coarser levels of detail over the same vertices, finest first
+};
+
+struct ImageData {
+    GLsizei width = 0;
+    GLsizei height = 0;
+    GLenum format = GL_RGB;
+    std::vector<unsigned char> pixels;
+};
+
+struct MeshData {
+    // Full detail plus up to three simplified levels
+    static constexpr int max_lods = 4;
+
+    std::vector<MaterialData> materials;
+    std::vector<MeshPart> parts;
+    BBox bbox;
+};
+
+#endif //SPACEOBJECTS_MESHDATA_H
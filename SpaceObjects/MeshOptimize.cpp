@@ -0,0 +1,273 @@
+#include "MeshOptimize.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+namespace {
+
+struct VertexKey {
+    GLfloat attributes[5]; // position, texture coordinates
+
+    bool operator==(const VertexKey& other) const {
+        return std::memcmp(attributes, other.attributes, sizeof(attributes)) == 0;
+    }
+};
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& key) const {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        const auto bytes = reinterpret_cast<const unsigned char*>(key.attributes);
+        for (size_t i = 0; i < sizeof(key.attributes); i++) {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+        }
+        return size_t(hash);
+    }
+};
+
+// Run of triangles in the output of Tipsify, [first, last) in elements
+struct Cluster {
+    size_t first, last;
+    glm::vec3 centroid;
+    glm::vec3 normal; // area-weighted
+    float facing;
+};
+
+glm::vec3 vertex_position(const std::vector<GLfloat>& vertices, GLuint index) {
+    return glm::vec3(vertices[3 * index], vertices[3 * index + 1], vertices[3 * index + 2]);
+}
+
+} // namespace
+
+float vertex_cache_acmr(const std::vector<GLuint>& elements, int cache_size) {
+    if (elements.empty()) return 0.0f;
+
+    // A vertex is cached while fewer than cache_size misses happened since its own
+    std::unordered_map<GLuint, int64_t> loaded;
+    int64_t misses = 0;
+    for (const auto index : elements) {
+        const auto entry = loaded.find(index);
+        if (entry == loaded.end() || misses - entry->second >= cache_size) {
+            loaded[index] = misses++;
+        }
+    }
+    return float(misses) / float(elements.size() / 3);
+}
+
+void weld_vertices(MeshPart& part) {
+    const auto num_vertices = part.vertices.size() / 3;
+    const bool has_texture_coords = part.texture_coords.size() >= 2 * num_vertices;
+
+    std::unordered_map<VertexKey, GLuint, VertexKeyHash> unique;
+    unique.reserve(num_vertices);
+
+    std::vector<GLuint> remap(num_vertices);
+    std::vector<GLfloat> vertices, texture_coords;
+    vertices.reserve(part.vertices.size());
+    texture_coords.reserve(part.texture_coords.size());
+
+    for (size_t i = 0; i < num_vertices; i++) {
+        VertexKey key;
+        std::memcpy(key.attributes, &part.vertices[3 * i], 3 * sizeof(GLfloat));
+        key.attributes[3] = has_texture_coords ? part.texture_coords[2 * i] : 0.0f;
+        key.attributes[4] = has_texture_coords ? part.texture_coords[2 * i + 1] : 0.0f;
+
+        const auto inserted = unique.emplace(key, GLuint(vertices.size() / 3));
+        remap[i] = inserted.first->second;
+        if (inserted.second) {
+            vertices.insert(vertices.end(), key.attributes, key.attributes + 3);
+            if (has_texture_coords) {
+                texture_coords.insert(texture_coords.end(), key.attributes + 3, key.attributes + 5);
+            }
+        }
+    }
+
+    part.vertices = std::move(vertices);
+    if (has_texture_coords) {
+        part.texture_coords = std::move(texture_coords);
+    }
+
+    for (auto& index : part.elements) {
+        index = remap[index];
+    }
+    for (auto& elements : part.lod_elements) {
+        for (auto& index : elements) {
+            index = remap[index];
+        }
+    }
+}
+
+std::vector<GLuint> optimize_vertex_cache(const std::vector<GLfloat>& vertices, const std::vector<GLuint>& elements, int cache_size) {
+    const auto num_vertices = vertices.size() / 3;
+    const auto num_triangles = elements.size() / 3;
+
+    // Triangles around each vertex, and how many of them are not emitted yet
+    std::vector<uint32_t> live(num_vertices, 0);
+    for (const auto index : elements) {
+        live[index]++;
+    }
+    std::vector<uint32_t> adjacency_first(num_vertices + 1, 0);
+    for (size_t v = 0; v < num_vertices; v++) {
+        adjacency_first[v + 1] = adjacency_first[v] + live[v];
+    }
+    std::vector<uint32_t> adjacency(elements.size());
+    {
+        auto fill = adjacency_first;
+        for (size_t i = 0; i < elements.size(); i++) {
+            adjacency[fill[elements[i]]++] = uint32_t(i / 3);
+        }
+    }
+
+    std::vector<int64_t> cached_at(num_vertices, 0);
+    std::vector<bool> emitted(num_triangles, false);
+    std::vector<GLuint> dead_ends, candidates;
+    int64_t time = cache_size + 1;
+    size_t cursor = 0;
+
+    std::vector<GLuint> result;
+    result.reserve(elements.size());
+    std::vector<size_t> cluster_starts;
+
+    int64_t fanning = num_triangles > 0 ? int64_t(elements[0]) : -1;
+    cluster_starts.push_back(0);
+
+    while (fanning >= 0) {
+        // Emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (auto a = adjacency_first[fanning]; a < adjacency_first[fanning + 1]; a++) {
+            const auto triangle = adjacency[a];
+            if (emitted[triangle]) continue;
+            emitted[triangle] = true;
+
+            for (int k = 0; k < 3; k++) {
+                const auto v = elements[3 * triangle + k];
+                result.push_back(v);
+                dead_ends.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cached_at[v] > cache_size) {
+                    cached_at[v] = time++;
+                }
+            }
+        }
+
+        // Next fanning vertex: the oldest candidate that stays in the cache while its
+        // remaining triangles are emitted
+        fanning = -1;
+        int64_t best_priority = 0;
+        for (const auto v : candidates) {
+            if (live[v] == 0) continue;
+            int64_t priority = 0;
+            if (time - cached_at[v] + 2 * int64_t(live[v]) <= cache_size) {
+                priority = time - cached_at[v];
+            }
+            if (priority > best_priority) {
+                best_priority = priority;
+                fanning = v;
+            }
+        }
+
+        // Dead end: a recently used vertex that still has triangles, else the next in input order
+        while (fanning < 0 && !dead_ends.empty()) {
+            const auto v = dead_ends.back();
+            dead_ends.pop_back();
+            if (live[v] > 0) fanning = v;
+        }
+        if (fanning < 0) {
+            while (cursor < num_vertices && live[cursor] == 0) cursor++;
+            if (cursor < num_vertices) {
+                fanning = int64_t(cursor);
+                // Nothing in the cache carries over, so the order of the runs is free
+                cluster_starts.push_back(result.size());
+            }
+        }
+    }
+
+    // Runs facing away from the center first
+    glm::vec3 center(0.0f);
+    float total_area = 0.0f;
+    std::vector<Cluster> clusters;
+    for (size_t c = 0; c < cluster_starts.size(); c++) {
+        Cluster cluster;
+        cluster.first = cluster_starts[c];
+        cluster.last = c + 1 < cluster_starts.size() ? cluster_starts[c + 1] : result.size();
+        if (cluster.first == cluster.last) continue;
+
+        cluster.centroid = glm::vec3(0.0f);
+        cluster.normal = glm::vec3(0.0f);
+        float area = 0.0f;
+        for (auto i = cluster.first; i < cluster.last; i += 3) {
+            const auto p0 = vertex_position(vertices, result[i]);
+            const auto p1 = vertex_position(vertices, result[i + 1]);
+            const auto p2 = vertex_position(vertices, result[i + 2]);
+            const auto cross = glm::cross(p1 - p0, p2 - p0);
+            const auto triangle_area = 0.5f * glm::length(cross);
+
+            cluster.centroid += triangle_area * (p0 + p1 + p2) / 3.0f;
+            cluster.normal += cross;
+            area += triangle_area;
+        }
+
+        center += cluster.centroid;
+        total_area += area;
+        if (area > 0.0f) {
+            cluster.centroid /= area;
+        }
+        clusters.push_back(cluster);
+    }
+    if (total_area > 0.0f) {
+        center /= total_area;
+    }
+
+    for (auto& cluster : clusters) {
+        const auto length = glm::length(cluster.normal);
+        cluster.facing = length > 0.0f ? glm::dot(cluster.centroid - center, cluster.normal / length) : 0.0f;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& first, const Cluster& second) {
+        return first.facing > second.facing;
+    });
+
+    std::vector<GLuint> sorted;
+    sorted.reserve(result.size());
+    for (const auto& cluster : clusters) {
+        sorted.insert(sorted.end(), result.begin() + cluster.first, result.begin() + cluster.last);
+    }
+    return sorted;
+}
+
+void optimize_vertex_fetch(MeshPart& part) {
+    const auto num_vertices = part.vertices.size() / 3;
+    const bool has_texture_coords = part.texture_coords.size() >= 2 * num_vertices;
+    const auto unused = GLuint(-1);
+
+    std::vector<GLuint> remap(num_vertices, unused);
+    GLuint next = 0;
+    const auto renumber = [&](std::vector<GLuint>& elements) {
+        for (auto& index : elements) {
+            if (remap[index] == unused) remap[index] = next++;
+            index = remap[index];
+        }
+    };
+    renumber(part.elements);
+    for (auto& elements : part.lod_elements) {
+        renumber(elements);
+    }
+
+    std::vector<GLfloat> vertices(3 * size_t(next)), texture_coords(has_texture_coords ? 2 * size_t(next) : 0);
+    for (size_t v = 0; v < num_vertices; v++) {
+        const auto to = remap[v];
+        if (to == unused) continue;
+        std::copy_n(&part.vertices[3 * v], 3, &vertices[3 * size_t(to)]);
+        if (has_texture_coords) {
+            std::copy_n(&part.texture_coords[2 * v], 2, &texture_coords[2 * size_t(to)]);
+        }
+    }
+
+    part.vertices = std::move(vertices);
+    if (has_texture_coords) {
+        part.texture_coords = std::move(texture_coords);
+    }
+}
@@ -0,0 +1,335 @@
+#include "MeshSimplify.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+// Sum of squared distances to a set of weighted planes, as a symmetric 4x4 matrix
+struct Quadric {
+    double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+    double weight;
+};
+
+Quadric plane_quadric(const glm::vec3& normal, float distance, double weight) {
+    const double x = normal.x, y = normal.y, z = normal.z, d = distance;
+    return {x * x * weight, x * y * weight, x * z * weight, x * d * weight,
+            y * y * weight, y * z * weight, y * d * weight,
+            z * z * weight, z * d * weight,
+            d * d * weight,
+            weight};
+}
+
+Quadric operator+(const Quadric& first, const Quadric& second) {
+    return {first.a00 + second.a00, first.a01 + second.a01, first.a02 + second.a02, first.a03 + second.a03,
+            first.a11 + second.a11, first.a12 + second.a12, first.a13 + second.a13,
+            first.a22 + second.a22, first.a23 + second.a23,
+            first.a33 + second.a33,
+            first.weight + second.weight};
+}
+
+// Weighted mean of the squared distances from point to the planes
+double evaluate(const Quadric& q, const glm::vec3& point) {
+    if (q.weight <= 0.0) return 0.0;
+
+    const double x = point.x, y = point.y, z = point.z;
+    const double sum = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z + q.a33
+                     + 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z + q.a03 * x + q.a13 * y + q.a23 * z);
+    return std::max(sum, 0.0) / q.weight;
+}
+
+// Borders of open meshes are held in place by planes through them, perpendicular to their face
+constexpr double BORDER_WEIGHT = 4.0;
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+};
+
+uint64_t edge_key(uint32_t a, uint32_t b) {
+    return a < b ? uint64_t(a) << 32 | b : uint64_t(b) << 32 | a;
+}
+
+// Vertices split along UV seams share a position; collapses work on positions so that seams stay closed
+std::vector<uint32_t> weld_positions(const std::vector<GLfloat>& vertices, std::vector<glm::vec3>& positions) {
+    const auto num_vertices = vertices.size() / 3;
+
+    std::vector<uint32_t> order(num_vertices);
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&vertices](uint32_t first, uint32_t second) {
+        return std::memcmp(&vertices[3 * first], &vertices[3 * second], 3 * sizeof(GLfloat)) < 0;
+    });
+
+    std::vector<uint32_t> position_of(num_vertices);
+    for (size_t i = 0; i < num_vertices; i++) {
+        const auto v = order[i];
+        if (i == 0 || std::memcmp(&vertices[3 * v], &vertices[3 * order[i - 1]], 3 * sizeof(GLfloat)) != 0) {
+            positions.emplace_back(vertices[3 * v], vertices[3 * v + 1], vertices[3 * v + 2]);
+        }
+        position_of[v] = uint32_t(positions.size() - 1);
+    }
+    return position_of;
+}
+
+class Simplifier {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> position_of;  // vertex -> position
+    std::vector<GLuint> representative; // position -> one of its vertices
+    std::vector<Quadric> quadrics;      // per position
+
+    // Triangles around each position
+    std::vector<uint32_t> fan_offsets;
+    std::vector<uint32_t> fan_triangles;
+
+public:
+    std::vector<GLuint> indices;
+
+    Simplifier(const std::vector<GLfloat>& vertices, const std::vector<GLuint>& elements) :
+        position_of(weld_positions(vertices, positions)),
+        representative(positions.size()),
+        quadrics(positions.size(), Quadric()) {
+
+        for (size_t v = 0; v < position_of.size(); v++) {
+            representative[position_of[v]] = GLuint(v);
+        }
+
+        indices.reserve(elements.size());
+        for (size_t i = 0; i + 2 < elements.size(); i += 3) {
+            if (!degenerate(elements[i], elements[i + 1], elements[i + 2])) {
+                indices.insert(indices.end(), {elements[i], elements[i + 1], elements[i + 2]});
+            }
+        }
+
+        initQuadrics();
+    }
+
+    size_t numTriangles() const {
+        return indices.size() / 3;
+    }
+
+    bool degenerate(GLuint a, GLuint b, GLuint c) const {
+        const auto pa = position_of[a], pb = position_of[b], pc = position_of[c];
+        return pa == pb || pb == pc || pc == pa;
+    }
+
+    glm::vec3 corner(size_t triangle, int k) const {
+        return positions[position_of[indices[3 * triangle + k]]];
+    }
+
+    void initQuadrics() {
+        struct HalfEdge {
+            uint64_t key;
+            uint32_t triangle;
+            int k;
+        };
+        std::vector<HalfEdge> half_edges;
+        half_edges.reserve(indices.size());
+
+        for (size_t t = 0; t < numTriangles(); t++) {
+            const auto normal = glm::cross(corner(t, 1) - corner(t, 0), corner(t, 2) - corner(t, 0));
+            const auto length = glm::length(normal);
+            if (length > 0.0f) {
+                const auto unit = normal / length;
+                const auto quadric = plane_quadric(unit, -glm::dot(unit, corner(t, 0)), 0.5 * length);
+                for (int k = 0; k < 3; k++) {
+                    auto& q = quadrics[position_of[indices[3 * t + k]]];
+                    q = q + quadric;
+                }
+            }
+
+            for (int k = 0; k < 3; k++) {
+                half_edges.push_back({edge_key(position_of[indices[3 * t + k]], position_of[indices[3 * t + (k + 1) % 3]]), uint32_t(t), k});
+            }
+        }
+
+        std::sort(half_edges.begin(), half_edges.end(), [](const HalfEdge& first, const HalfEdge& second) {
+            return first.key < second.key;
+        });
+
+        for (size_t i = 0; i < half_edges.size(); i++) {
+            const auto& edge = half_edges[i];
+            const auto shared = (i > 0 && half_edges[i - 1].key == edge.key)
+                             || (i + 1 < half_edges.size() && half_edges[i + 1].key == edge.key);
+            if (shared) continue;
+
+            const auto a = corner(edge.triangle, edge.k);
+            const auto b = corner(edge.triangle, (edge.k + 1) % 3);
+            const auto face_normal = glm::cross(b - a, corner(edge.triangle, (edge.k + 2) % 3) - a);
+            const auto normal = glm::cross(b - a, face_normal);
+            const auto length = glm::length(normal);
+            if (length == 0.0f) continue;
+
+            const auto unit = normal / length;
+            const auto edge_length = glm::length(b - a);
+            const auto quadric = plane_quadric(unit, -glm::dot(unit, a), BORDER_WEIGHT * edge_length * edge_length);
+            quadrics[edge.key >> 32] = quadrics[edge.key >> 32] + quadric;
+            quadrics[edge.key & 0xffffffffu] = quadrics[edge.key & 0xffffffffu] + quadric;
+        }
+    }
+
+    void buildFans() {
+        fan_offsets.assign(positions.size() + 1, 0);
+        for (const auto index : indices) {
+            fan_offsets[position_of[index] + 1]++;
+        }
+        std::partial_sum(fan_offsets.begin(), fan_offsets.end(), fan_offsets.begin());
+
+        fan_triangles.resize(indices.size());
+        auto cursor = fan_offsets;
+        for (size_t i = 0; i < indices.size(); i++) {
+            fan_triangles[cursor[position_of[indices[i]]]++] = uint32_t(i / 3);
+        }
+    }
+
+    std::vector<Collapse> findCollapses(double max_cost) const {
+        std::vector<uint64_t> edges;
+        edges.reserve(indices.size());
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                edges.push_back(edge_key(position_of[indices[i + k]], position_of[indices[i + (k + 1) % 3]]));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        std::vector<Collapse> collapses;
+        collapses.reserve(edges.size());
+        for (const auto edge : edges) {
+            const auto a = uint32_t(edge >> 32), b = uint32_t(edge & 0xffffffffu);
+            const auto quadric = quadrics[a] + quadrics[b];
+            const auto cost_ab = evaluate(quadric, positions[b]);
+            const auto cost_ba = evaluate(quadric, positions[a]);
+
+            const auto collapse = cost_ab <= cost_ba ? Collapse{a, b, cost_ab} : Collapse{b, a, cost_ba};
+            if (collapse.cost <= max_cost) {
+                collapses.push_back(collapse);
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& first, const Collapse& second) {
+            return first.cost < second.cost;
+        });
+        return collapses;
+    }
+
+    // Whether moving from onto to turns any remaining triangle around from upside down
+    bool flips(uint32_t from, uint32_t to) const {
+        for (auto i = fan_offsets[from]; i < fan_offsets[from + 1]; i++) {
+            const auto t = fan_triangles[i];
+
+            glm::vec3 before[3], after[3];
+            bool collapses = false;
+            for (int k = 0; k < 3; k++) {
+                const auto position = position_of[indices[3 * t + k]];
+                collapses = collapses || position == to;
+                before[k] = positions[position];
+                after[k] = position == from ? positions[to] : before[k];
+            }
+            if (collapses) continue;
+
+            const auto normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+            const auto normal_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(normal_before, normal_after) <= 0.0f) return true;
+        }
+        return false;
+    }
+
+    // One round of independent collapses, cheapest first. False if none could be made
+    bool collapseRound(size_t target_triangles, double max_cost) {
+        buildFans();
+        const auto collapses = findCollapses(max_cost);
+
+        std::vector<uint32_t> collapse_target(positions.size());
+        std::iota(collapse_target.begin(), collapse_target.end(), 0u);
+        std::vector<uint8_t> locked(positions.size(), 0);
+
+        const auto excess = numTriangles() - target_triangles;
+        size_t removed = 0;
+        for (const auto& collapse : collapses) {
+            if (removed >= excess) break;
+            if (locked[collapse.from] || locked[collapse.to] || flips(collapse.from, collapse.to)) continue;
+
+            collapse_target[collapse.from] = collapse.to;
+            quadrics[collapse.to] = quadrics[collapse.to] + quadrics[collapse.from];
+
+            // Neighbours keep their triangles unchanged for the rest of the round
+            for (auto i = fan_offsets[collapse.from]; i < fan_offsets[collapse.from + 1]; i++) {
+                const auto t = fan_triangles[i];
+                bool collapses = false;
+                for (int k = 0; k < 3; k++) {
+                    const auto position = position_of[indices[3 * t + k]];
+                    locked[position] = 1;
+                    collapses = collapses || position == collapse.to;
+                }
+                removed += collapses;
+            }
+        }
+        if (removed == 0) return false;
+
+        // A vertex follows its position onto a vertex it shares a triangle with, so it stays on its side of a seam
+        std::vector<GLuint> vertex_target(position_of.size());
+        for (size_t v = 0; v < vertex_target.size(); v++) {
+            vertex_target[v] = collapse_target[position_of[v]] == position_of[v] ? GLuint(v) : representative[collapse_target[position_of[v]]];
+        }
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                const auto v = indices[i + k];
+                const auto to = collapse_target[position_of[v]];
+                if (to == position_of[v]) continue;
+
+                for (int j = 0; j < 3; j++) {
+                    if (position_of[indices[i + j]] == to) vertex_target[v] = indices[i + j];
+                }
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            const auto a = vertex_target[indices[i]], b = vertex_target[indices[i + 1]], c = vertex_target[indices[i + 2]];
+            if (degenerate(a, b, c)) continue;
+
+            indices[kept++] = a;
+            indices[kept++] = b;
+            indices[kept++] = c;
+        }
+        indices.resize(kept);
+
+        return true;
+    }
+};
+
+} // namespace
+
+std::vector<GLuint> simplify_mesh(const std::vector<GLfloat>& vertices, const std::vector<GLuint>& elements,
+                                  size_t target_triangles, float max_error) {
+    Simplifier simplifier(vertices, elements);
+
+    const auto max_cost = double(max_error) * max_error;
+    while (simplifier.numTriangles() > target_triangles && simplifier.collapseRound(target_triangles, max_cost)) {}
+
+    return std::move(simplifier.indices);
+}
+
+void generate_lods(MeshData& data) {
+    const auto model_size = glm::length(data.bbox.max - data.bbox.min);
+
+    // Surface deviation allowed at each level, relative to the model size
+    const float max_errors[MeshData::max_lods - 1] = {0.005f, 0.02f, 0.05f};
+
+    for (auto& part : data.parts) {
+        part.lod_elements.clear();
+        part.lod_elements.reserve(MeshData::max_lods - 1);
+
+        for (int level = 1; level < MeshData::max_lods; level++) {
+            const auto& previous = level == 1 ? part.elements : part.lod_elements.back();
+            auto elements = simplify_mesh(part.vertices, previous, previous.size() / 6, max_errors[level - 1] * model_size);
+
+            // Too close to the previous level to be worth drawing instead of it
+            if (elements.size() * 5 > previous.size() * 4) break;
+
+            part.lod_elements.push_back(std::move(elements));
+        }
+    }
+}
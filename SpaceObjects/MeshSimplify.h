@@ -0,0 +1,19 @@
+#ifndef SPACEOBJECTS_MESHSIMPLIFY_H
+#define SPACEOBJECTS_MESHSIMPLIFY_H
+
+#include <vector>
+#include <glad/glad.h>
+
+#include "MeshData.h"
+
+// Triangle list over the same vertices with at most target_triangles triangles, made by
+// quadric error edge collapses. Vertices only ever move onto other existing vertices, so all
+// levels of detail of a part share its vertex buffer. Collapses that would move the surface
+// further than max_error (model units) are not made, the result may stay above the target
+std::vector<GLuint> simplify_mesh(const std::vector<GLfloat>& vertices, const std::vector<GLuint>& elements,
+                                  size_t target_triangles, float max_error);
+
+// Fills lod_elements of every part, each level with about half the triangles of the previous one
+void generate_lods(MeshData& data);
+
+#endif //SPACEOBJECTS_MESHSIMPLIFY_H
@@ -1,43 +1,41 @@
 #ifndef SPACEOBJECTS_MODEL_H
 #define SPACEOBJECTS_MODEL_H
 
-#include <string>
-#include <vector>
-#include <assimp/scene.h>
+#include <cstdint>
+#include <memory>
 #include <glm/gtx/quaternion.hpp>
 
 #include "BBox.h"
-#include "Object.h"
-
-class Model {
-    std::string model_location;
-
-    void process_object(const aiNode* node, const aiScene* scene);
-
-    void process_textures(const aiScene* scene);
+#include "MeshAsset.h"
 
+// Per-entity state. The mesh itself is shared through the asset pointer,
+// so copying an instance never touches mesh data
+class ModelInstance {
  public:
-    std::vector<Object> objects;
-    std::vector<Material> materials;
-
-    BBox bbox;
+    std::shared_ptr<const MeshAsset> asset;
 
     glm::vec3 world_pos;
-    glm::mat4 rot;
+    glm::quat rot;
     float scale_coef = 1.0;
 
     float damage = 10.0;
 
-    Model() = default;
+    // Key of the instance in the collision world, assigned at spawn
+    uint32_t id = 0;
+
+    ModelInstance() = default;
 
-    explicit Model(const std::string& path);
+    explicit ModelInstance(const std::shared_ptr<const MeshAsset>& asset) :
+        asset(asset),
+        world_pos(0.0f, 0.0f, 0.0f),
+        rot(1.0f, 0.0f, 0.0f, 0.0f) {}
 
     void move(const glm::vec3& translation) {
         world_pos += translation;
     }
 
     void rotate(float angle, const glm::vec3& axis) {
-        rot = glm::rotate(rot, angle, axis);
+        rot = rot * glm::angleAxis(angle, axis);
     }
 
     void scale(float coef) {
@@ -45,12 +43,11 @@ class Model {
     }
 
     glm::mat4 getWorldTransform() const {
-        return glm::translate(glm::mat4(1.0f), world_pos) * rot * glm::scale(glm::mat4(1.0f), glm::vec3(scale_coef));
+        return glm::translate(glm::mat4(1.0f), world_pos) * glm::toMat4(rot) * glm::scale(glm::mat4(1.0f), glm::vec3(scale_coef));
     }
 
     BBox getBBox() const {
-        const auto transform = getWorldTransform();
-        return BBox(transform * glm::vec4(bbox.min, 1.0f), transform * glm::vec4(bbox.max, 1.0f));
+        return asset->bbox.transformed(getWorldTransform());
     }
 
     bool dead = false;
@@ -64,18 +61,18 @@ class Model {
     }
 };
 
-class Asteroid : public Model {
+class Asteroid : public ModelInstance {
 public:
     glm::vec3 velocity;
 
-    Asteroid(const Model& model, const glm::vec3& velocity) :
-        Model(model),
+    Asteroid(const ModelInstance& model, const glm::vec3& velocity) :
+        ModelInstance(model),
         velocity(velocity) {
 
         const auto direction = glm::normalize(velocity);
         const auto q = glm::rotation({0.0f, 0.0f, 1.0f}, direction);
 
-        rot = glm::toMat4(q) * rot;
+        rot = q * rot;
     }
 
     void moveAuto(float alpha) {
@@ -1,8 +1,14 @@
 #include "ModelFactories.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <queue>
 #include <glm/gtx/norm.hpp>
 
-ModelFactory::ModelFactory() {
+ModelFactory::ModelFactory(AssetMode mode, unsigned num_threads, std::map<ModelName, MeshData>* meshes) {
     model_path = {
         {ModelName::E45_AIRCRAFT, "models/E-45-Aircraft/E 45 Aircraft_obj.obj"},
         {ModelName::ROCKET, "models/rocket/Rocket.obj"},
@@ -14,17 +20,71 @@ ModelFactory::ModelFactory() {
     };
 
     // Buffer all models
-    for (const auto& pair : model_path) {
-        const auto& model_name = pair.first;
-        const auto& path = pair.second;
+    const std::vector<std::pair<ModelName, std::string>> jobs(model_path.begin(), model_path.end());
+    std::vector<ModelSource> sources(jobs.size());
+    std::vector<LoadStats> job_stats(jobs.size());
+    std::vector<std::exception_ptr> errors(jobs.size());
 
-        model_buffer[pair.first] = Model(path);
+    std::mutex ready_mutex;
+    std::condition_variable ready_cv;
+    std::queue<size_t> ready;
+    std::atomic<size_t> next_job(0);
+
+    const auto worker = [&]() {
+        for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+            // The job is reported as ready either way, or the upload loop would wait for it forever
+            try {
+                sources[i] = MeshAsset::load(jobs[i].second, &job_stats[i], mode);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+            {
+                std::lock_guard<std::mutex> lock(ready_mutex);
+                ready.push(i);
+            }
+            ready_cv.notify_one();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < std::max(num_threads, 1u) && i < jobs.size(); i++) {
+        workers.emplace_back(worker);
+    }
+
+    // Upload models in the order they finish loading
+    for (size_t done = 0; done < jobs.size(); done++) {
+        size_t i;
+        {
+            std::unique_lock<std::mutex> lock(ready_mutex);
+            ready_cv.wait(lock, [&]() { return !ready.empty(); });
+            i = ready.front();
+            ready.pop();
+        }
+
+        if (errors[i]) {
+            next_job = jobs.size();
+            for (auto& thread : workers) {
+                thread.join();
+            }
+            std::rethrow_exception(errors[i]);
+        }
+
+        stats += job_stats[i];
+        model_buffer[jobs[i].first] = std::make_shared<const MeshAsset>(sources[i], &stats, mode);
+        if (meshes != nullptr) {
+            (*meshes)[jobs[i].first] = std::move(sources[i].mesh);
+        }
+        sources[i] = ModelSource();
+    }
+
+    for (auto& thread : workers) {
+        thread.join();
     }
 }
 
-Model
+ModelInstance
 ModelFactory::get_model(ModelName model_name, const glm::vec3 &position, const glm::vec3 &rotation, float scale) const {
-    Model model = model_buffer.at(model_name);
+    ModelInstance model(model_buffer.at(model_name));
 
     model.scale(scale);
     model.move(position);
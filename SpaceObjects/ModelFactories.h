@@ -4,6 +4,7 @@
 #include "Model.h"
 
 #include <map>
+#include <thread>
 
 enum ModelName {
     E45_AIRCRAFT,
@@ -17,13 +18,26 @@ enum ModelName {
 
 class ModelFactory {
     std::map<ModelName, std::string> model_path;
-    std::map<ModelName, Model> model_buffer;
+    std::map<ModelName, std::shared_ptr<const MeshAsset>> model_buffer;
+    LoadStats stats;
 public:
-    ModelFactory();
+    // Meshes are parsed and textures decoded on num_threads workers, GL uploads stay on the calling thread.
+    // An exception thrown by a worker is rethrown here once the other workers have stopped.
+    // The parsed MeshData of every model is moved into meshes when it is given
+    explicit ModelFactory(AssetMode mode = AssetMode::RENDER, unsigned num_threads = std::thread::hardware_concurrency(),
+                          std::map<ModelName, MeshData>* meshes = nullptr);
+
+    const LoadStats& load_stats() const {
+        return stats;
+    }
+
+    std::shared_ptr<const MeshAsset> get_asset(ModelName model_name) const {
+        return model_buffer.at(model_name);
+    }
 
-    Model get_model(ModelName model_name, const glm::vec3& position = glm::vec3(0.0f), const glm::vec3& rotation = glm::vec3(0.0f), float scale = 1.0f) const;
+    ModelInstance get_model(ModelName model_name, const glm::vec3& position = glm::vec3(0.0f), const glm::vec3& rotation = glm::vec3(0.0f), float scale = 1.0f) const;
 
-    Model get_random_enemy(const glm::vec3& position) const {
+    ModelInstance get_random_enemy(const glm::vec3& position) const {
         const float x = rand() % 100 - 50;
         const float y = rand() % 50 - 25;
         const auto src = glm::vec3(x, y, -500.0f) + position;
@@ -1,74 +1,119 @@
 #include "Object.h"
 
+#include <cmath>
+#include <cstddef>
 #include <random>
 
-Object::Object(const std::vector<float>& vertices, const std::vector<GLuint>& elements, const std::vector<GLfloat>& texture_coords, const Material& material) :
-    vertices(vertices),
-    elements(elements),
-    texture_coords(texture_coords),
-    material(material),
-    world_pos(0.0f, 0.0f, 0.0f),
-    rot(1.0f) {
+Object::Object(const MeshPart& part, const Material& material, const std::vector<GLuint>& instance_buffers) :
+    material(material) {
+
+    const auto& layout = vertexLayout();
+    const auto num_vertices = part.vertices.size() / 3;
+
+    glm::vec3 min(INFINITY), max(-INFINITY);
+    for (size_t i = 0; i < num_vertices; i++) {
+        const glm::vec3 vertex(part.vertices[3 * i], part.vertices[3 * i + 1], part.vertices[3 * i + 2]);
+        min = glm::min(min, vertex);
+        max = glm::max(max, vertex);
+    }
+    if (num_vertices == 0) {
+        min = max = glm::vec3(0.0f);
+    }
+    position_offset = min;
+    position_scale = max - min;
+
+    std::vector<GLfloat> positions(part.vertices.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        const auto extent = position_scale[i % 3];
+        positions[i] = extent > 0.0f ? (part.vertices[i] - position_offset[i % 3]) / extent : 0.0f;
+    }
+    const auto vertices = layout.interleave({positions.data(), part.texture_coords.data()}, num_vertices);
+
+    std::vector<GLuint> elements = part.elements;
+    lod_first.push_back(0);
+    lod_count.push_back(GLsizei(part.elements.size()));
+    for (const auto& lod : part.lod_elements) {
+        lod_first.push_back(GLsizei(elements.size()));
+        lod_count.push_back(GLsizei(lod.size()));
+        elements.insert(elements.end(), lod.begin(), lod.end());
+    }
+
+    index_type = indexType(num_vertices);
+    std::vector<GLushort> short_elements;
+    if (index_type == GL_UNSIGNED_SHORT) {
+        short_elements.assign(elements.begin(), elements.end());
+    }
 
-    glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
-    glGenBuffers(1, &TBO);
 
-    glBindVertexArray(VAO);
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+    vertex_arrays.resize(instance_buffers.size());
+    glGenVertexArrays(GLsizei(vertex_arrays.size()), vertex_arrays.data());
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    for (size_t lod = 0; lod < vertex_arrays.size(); lod++) {
+        gl_state().bindVertexArray(vertex_arrays[lod]);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(GLuint), elements.data(), GL_STATIC_DRAW);
+        gl_state().bindBuffer(GL_ARRAY_BUFFER, VBO);
+        layout.apply();
 
-    glBindBuffer(GL_ARRAY_BUFFER, TBO);
-    glBufferData(GL_ARRAY_BUFFER, texture_coords.size() * sizeof(GLfloat), texture_coords.data(), GL_STATIC_DRAW);
+        gl_state().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        if (lod == 0) {
+            if (index_type == GL_UNSIGNED_SHORT) {
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, short_elements.size() * sizeof(GLushort), short_elements.data(), GL_STATIC_DRAW);
+            } else {
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(GLuint), elements.data(), GL_STATIC_DRAW);
+            }
+        }
 
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+        gl_state().bindBuffer(GL_ARRAY_BUFFER, instance_buffers[lod]);
 
-    glBindVertexArray(0);
-}
+        // mat4 takes four consecutive vec4 slots
+        for (GLuint i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(2 + i);
+            glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  reinterpret_cast<const void*>(offsetof(InstanceData, transform) + i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(2 + i, 1);
+        }
 
-Object Object::create(const aiMesh *mesh, const Material &material) {
-    std::vector<GLfloat> vertices;
-    std::vector<GLuint> elements;
-    std::vector<GLfloat> texture_coords;
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 2, GL_FLOAT, GL_FALSE, sizeof(InstanceData), reinterpret_cast<const void*>(offsetof(InstanceData, opacity)));
+        glVertexAttribDivisor(6, 1);
+    }
 
-    // Vertices
-    for (int i = 0; i < mesh->mNumVertices; i++) {
-        const auto& vertex = mesh->mVertices[i];
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, 0);
 
-        vertices.push_back(vertex.x);
-        vertices.push_back(vertex.y);
-        vertices.push_back(vertex.z);
+    gl_state().bindVertexArray(0);
+}
 
-        // Texture coordinates
-        texture_coords.push_back(mesh->mTextureCoords[0][i].x);
-        texture_coords.push_back(mesh->mTextureCoords[0][i].y);
-    }
+const VertexLayout& Object::vertexLayout() {
+    static const auto layout = VertexLayout()
+        .add(0, 3, GL_UNSIGNED_SHORT)
+        .add(1, 2, GL_HALF_FLOAT);
+    return layout;
+}
 
-    // Indices
-    for (int i = 0; i < mesh->mNumFaces; i++) {
-        const auto& face = mesh->mFaces[i];
+GLenum Object::indexType(size_t num_vertices) {
+    return num_vertices <= 0x10000 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
 
-        for (int j = 0; j < face.mNumIndices; j++) {
-            elements.push_back(face.mIndices[j]);
-        }
+size_t Object::bufferBytes(const MeshPart& part) {
+    size_t num_elements = part.elements.size();
+    for (const auto& lod : part.lod_elements) {
+        num_elements += lod.size();
     }
 
-    return Object(vertices, elements, texture_coords, material);
+    const auto num_vertices = part.vertices.size() / 3;
+    const auto index_size = indexType(num_vertices) == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    return num_vertices * vertexLayout().getStride() + num_elements * index_size;
 }
 
 SkyBox SkyBox::create(const std::array<std::string, 6>& file_names) {
     GLuint texture_id;
     glGenTextures(1, &texture_id);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, texture_id);
+    gl_state().bindTexture(GL_TEXTURE_CUBE_MAP, texture_id);
 
     for (int i = 0; i < file_names.size(); i++) {
         uint image = ilGenImage();
@@ -137,21 +182,21 @@ SkyBox::SkyBox(GLuint texture_index) : texture_index(texture_index) {
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
-    glBindVertexArray(VAO);
+    gl_state().bindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    gl_state().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(GLuint), elements.data(), GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
 
-    glBindVertexArray(0);
+    gl_state().bindVertexArray(0);
 }
 
 Particles::Particles(int nb_particles) {
@@ -168,43 +213,41 @@ Particles::Particles(int nb_particles) {
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
 
-    glBindVertexArray(VAO);
+    gl_state().bindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, 3 * nb_particles, vertices.data(), GL_STATIC_DRAW);
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, 3 * nb_particles * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 
-    glBindVertexArray(0);
+    gl_state().bindVertexArray(0);
 }
 
 Crosshair::Crosshair() {
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
 
-    glBindVertexArray(VAO);
+    gl_state().bindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
 
-    glBindVertexArray(0);
+    gl_state().bindVertexArray(0);
 }
 
-Laser::Laser() {
+Laser::Laser(StreamBuffer& stream) : stream(stream) {
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
 
-    glBindVertexArray(VAO);
+    gl_state().bindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, 2 * 3 * sizeof(GLfloat), nullptr, GL_STATIC_DRAW);
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, stream.getBuffer());
 
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 
-    glBindVertexArray(0);
+    gl_state().bindVertexArray(0);
 }
@@ -1,43 +1,57 @@
 #ifndef SPACEOBJECTS_OBJECT_H
 #define SPACEOBJECTS_OBJECT_H
 
+#include <algorithm>
 #include <array>
 #include <vector>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <assimp/mesh.h>
 #include <il.h>
 
 #include "common.h"
+#include "GLState.h"
 #include "Material.h"
+#include "MeshData.h"
+#include "StreamBuffer.h"
+#include "VertexLayout.h"
+
+// Per-instance vertex attributes, locations 2-5 (transform) and 6 (opacity, magnitude)
+struct InstanceData {
+    glm::mat4 transform;
+    float opacity;
+    float magnitude;
+};
 
+// One mesh part uploaded to the GPU. CPU copies of the geometry are not kept.
+// Vertices are interleaved in VBO: positions as 16-bit fractions of the part's bounds, decoded
+// in the vertex shader from position_offset and position_scale, and texture coordinates as
+// half floats. All levels of detail share the vertex buffer; their index lists follow each
+// other in EBO, 16-bit when the part has few enough vertices
 class Object {
 protected:
-    GLuint VAO, VBO, EBO, TBO;
+    GLuint VBO, EBO;
+    GLenum index_type;
+    std::vector<GLuint> vertex_arrays;
+    std::vector<GLsizei> lod_first, lod_count; // index range of each level the part has
+    glm::vec3 position_offset, position_scale;
     Material material;
 
-public:
-    std::vector<GLfloat> vertices;
-    std::vector<GLuint> elements;
-    std::vector<GLfloat> texture_coords;
-
-    glm::vec3 world_pos;
-    glm::mat4 rot;
+    size_t range(int lod) const {
+        return std::min(size_t(lod), lod_count.size() - 1);
+    }
 
-    Object(const std::vector<float>& vertices, const std::vector<GLuint>& elements, const std::vector<GLfloat>& texture_coords, const Material& material);
+public:
+    // One vertex array per level of detail of the asset, each taking its instance attributes
+    // from the matching InstanceData buffer. Levels beyond those of the part draw its coarsest one
+    Object(const MeshPart& part, const Material& material, const std::vector<GLuint>& instance_buffers);
 
-    void move(const glm::vec3& translation) {
-        world_pos += translation;
-    }
+    static const VertexLayout& vertexLayout();
 
-    void rotate(float angle, const glm::vec3& axis) {
-        rot = glm::rotate(rot, angle, axis);
-    }
+    static GLenum indexType(size_t num_vertices);
 
-    glm::mat4 getWorldTransform() const {
-        return glm::translate(glm::mat4(1.0f), world_pos) * rot;
-    }
+    // Size of the vertex and index buffers the part is uploaded to
+    static size_t bufferBytes(const MeshPart& part);
 
     glm::vec4 getDiffuseColor() const {
         return material.diffuse_color;
@@ -48,20 +62,41 @@ public:
     }
 
     bool haveTexture() const {
-        return material.diffuse_texture != 0;
+        return material.diffuse_texture != nullptr;
     }
 
-    void draw() const {
-        glBindTexture(GL_TEXTURE_2D, material.diffuse_texture);
-        glBindVertexArray(VAO);
+    // Array texture and layer of the diffuse texture
+    GLuint getTexture() const {
+        return haveTexture() ? material.diffuse_texture->get() : 0;
+    }
 
-        GL_CHECK_ERRORS;
-        glDrawElements(GL_TRIANGLES, elements.size(), GL_UNSIGNED_INT, nullptr);
-        GL_CHECK_ERRORS;
-        glBindVertexArray(0);
+    GLint getTextureLayer() const {
+        return haveTexture() ? material.diffuse_texture->layer() : 0;
     }
 
-    static Object create(const aiMesh* mesh, const Material& material);
+    GLuint getVertexArray(int lod = 0) const {
+        return vertex_arrays[lod];
+    }
+
+    GLsizei getFirstElement(int lod = 0) const {
+        return lod_first[range(lod)];
+    }
+
+    GLsizei getNumElements(int lod = 0) const {
+        return lod_count[range(lod)];
+    }
+
+    GLenum getIndexType() const {
+        return index_type;
+    }
+
+    glm::vec3 getPositionOffset() const {
+        return position_offset;
+    }
+
+    glm::vec3 getPositionScale() const {
+        return position_scale;
+    }
 };
 
 class SkyBox {
@@ -75,14 +110,13 @@ public:
     explicit SkyBox(GLuint texture_index);
 
     void draw() const {
-        glBindTexture(GL_TEXTURE_CUBE_MAP, texture_index);
+        gl_state().bindTexture(GL_TEXTURE_CUBE_MAP, texture_index);
         GL_CHECK_ERRORS;
-        glBindVertexArray(VAO);
+        gl_state().bindVertexArray(VAO);
         GL_CHECK_ERRORS;
 
         glDrawElements(GL_TRIANGLES, elements.size(), GL_UNSIGNED_INT, nullptr);
         GL_CHECK_ERRORS;
-        glBindVertexArray(0);
     }
 
     static SkyBox create(const std::array<std::string, 6>& file_names);
@@ -96,12 +130,10 @@ public:
     explicit Particles(int nb_particles);
 
     void draw() const {
-        glBindVertexArray(VAO);
+        gl_state().bindVertexArray(VAO);
 
         glDrawArrays(GL_POINTS, 0, vertices.size() / 3);
         GL_CHECK_ERRORS;
-
-        glBindVertexArray(0);
     }
 };
 
@@ -118,37 +150,31 @@ public:
     Crosshair();
 
     void draw() const {
-        glBindVertexArray(VAO);
+        gl_state().bindVertexArray(VAO);
 
         glDrawArrays(GL_LINE_LOOP, 0, 3);
         GL_CHECK_ERRORS;
-
-        glBindVertexArray(0);
     }
 };
 
 class Laser {
-    GLuint VAO, VBO;
+    GLuint VAO;
+    StreamBuffer& stream;
 
 public:
-    int recharge = 0;
-
-    Laser();
-
-    void draw(const glm::vec3& src, const glm::vec3& dst) const {
-        glBindVertexArray(VAO);
+    explicit Laser(StreamBuffer& stream);
 
-        GLfloat vertices[] {
+    void draw(const glm::vec3& src, const glm::vec3& dst) {
+        const GLfloat vertices[] {
             src.x, src.y, src.z,
             dst.x, dst.y, dst.z,
         };
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        const auto first = stream.write(vertices, 2, 3 * sizeof(GLfloat));
+        if (first < 0) return;
 
-        glDrawArrays(GL_LINES, 0, 2);
+        gl_state().bindVertexArray(VAO);
 
-        glBindVertexArray(0);
+        glDrawArrays(GL_LINES, first, 2);
     }
 };
 
@@ -0,0 +1,238 @@
+#include "ParticleSystem.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+namespace {
+
+// Must match hash() and next_random() in the update shader
+uint32_t hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float next_random(uint32_t& state) {
+    state = hash(state);
+    return float(state >> 8) * (1.0f / 16777216.0f);
+}
+
+void spawn_particle(GpuParticle& particle, uint32_t id, uint32_t frame, const ParticleSpawns& spawns, int e) {
+    uint32_t state = hash(id ^ hash(frame));
+
+    const auto x = 2.0f * next_random(state) - 1.0f;
+    const auto y = 2.0f * next_random(state) - 1.0f;
+    const auto z = 2.0f * next_random(state) - 1.0f;
+    const auto speed = spawns.spread[e] * next_random(state);
+    const auto life = 0.5f + 0.5f * next_random(state);
+
+    auto direction = glm::vec3(x, y, z);
+    const auto length = glm::length(direction);
+    direction = length > 1e-6f ? direction / length : glm::vec3(0.0f);
+
+    particle.position = spawns.position[e];
+    particle.age = 0.0f;
+    particle.velocity = spawns.velocity[e] + speed * direction;
+    particle.lifetime = spawns.lifetime[e] * life;
+}
+
+const ShaderProgram& with_particle_feedback(ShaderProgram& program) {
+    if (!program.SetFeedbackVaryings({"out_position", "out_age", "out_velocity", "out_lifetime"})) {
+        std::cerr << "Couldn't link the particle update program for transform feedback" << std::endl;
+    }
+    return program;
+}
+
+} // namespace
+
+constexpr int ParticleSpawns::max_emissions;
+constexpr float ParticleSystem::drag;
+constexpr uint32_t ParticleSystem::check_interval;
+
+void update_particles_reference(std::vector<GpuParticle>& particles, const ParticleSpawns& spawns,
+                                float dt, float drag, uint32_t frame) {
+    const auto capacity = uint32_t(particles.size());
+    const auto damping = std::max(1.0f - drag * dt, 0.0f);
+
+    for (uint32_t id = 0; id < capacity; id++) {
+        auto& particle = particles[id];
+
+        bool spawned = false;
+        for (int e = 0; e < spawns.size; e++) {
+            if ((id + capacity - spawns.start[e]) % capacity < spawns.count[e]) {
+                spawn_particle(particle, id, frame, spawns, e);
+                spawned = true;
+            }
+        }
+
+        if (!spawned && particle.age < particle.lifetime) {
+            particle.position += particle.velocity * dt;
+            particle.velocity *= damping;
+            particle.age += dt;
+        }
+    }
+}
+
+ParticleSystem::UpdateUniforms::UpdateUniforms(const ShaderProgram& program) :
+    dt(program.GetUniform("dt")),
+    drag(program.GetUniform("drag")),
+    frame(program.GetUniform("frame")),
+    capacity(program.GetUniform("capacity")),
+    num_emissions(program.GetUniform("num_emissions")),
+    emission_start(program.GetUniform("emission_start")),
+    emission_count(program.GetUniform("emission_count")),
+    emission_position(program.GetUniform("emission_position")),
+    emission_velocity(program.GetUniform("emission_velocity")),
+    emission_spread(program.GetUniform("emission_spread")),
+    emission_lifetime(program.GetUniform("emission_lifetime")) {}
+
+ParticleSystem::ParticleSystem(ShaderProgram& update_program, uint32_t capacity) :
+    update_program(with_particle_feedback(update_program)),
+    uniforms(this->update_program),
+    capacity(std::max(capacity, 1u)) {
+
+    // Zero age and lifetime: every slot starts dead
+    const std::vector<GpuParticle> initial(this->capacity, GpuParticle{});
+
+    glGenBuffers(2, buffers);
+    glGenVertexArrays(2, vertex_arrays);
+
+    for (int i = 0; i < 2; i++) {
+        gl_state().bindVertexArray(vertex_arrays[i]);
+
+        gl_state().bindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, initial.size() * sizeof(GpuParticle), initial.data(), GL_DYNAMIC_COPY);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (GLvoid*) offsetof(GpuParticle, position));
+
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (GLvoid*) offsetof(GpuParticle, age));
+
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (GLvoid*) offsetof(GpuParticle, velocity));
+
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (GLvoid*) offsetof(GpuParticle, lifetime));
+    }
+
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, 0);
+    gl_state().bindVertexArray(0);
+}
+
+ParticleSpawns ParticleSystem::takeSpawns() {
+    ParticleSpawns spawns;
+    while (!pending.empty() && spawns.size < ParticleSpawns::max_emissions) {
+        const auto& emission = pending.front();
+        const auto e = spawns.size++;
+
+        spawns.start[e] = cursor;
+        spawns.count[e] = std::min(emission.count, capacity);
+        spawns.position[e] = emission.position;
+        spawns.velocity[e] = emission.velocity;
+        spawns.spread[e] = emission.spread;
+        spawns.lifetime[e] = emission.lifetime;
+
+        cursor = (cursor + spawns.count[e]) % capacity;
+        pending.pop_front();
+    }
+    return spawns;
+}
+
+void ParticleSystem::update(float dt) {
+    const auto spawns = takeSpawns();
+
+    update_program.StartUseShader();
+
+    update_program.SetUniform(uniforms.dt, dt);
+    update_program.SetUniform(uniforms.drag, drag);
+    update_program.SetUniform(uniforms.frame, frame);
+    update_program.SetUniform(uniforms.capacity, capacity);
+    update_program.SetUniform(uniforms.num_emissions, spawns.size);
+    if (spawns.size != 0) {
+        update_program.SetUniform(uniforms.emission_start, spawns.start, spawns.size);
+        update_program.SetUniform(uniforms.emission_count, spawns.count, spawns.size);
+        update_program.SetUniform(uniforms.emission_position, spawns.position, spawns.size);
+        update_program.SetUniform(uniforms.emission_velocity, spawns.velocity, spawns.size);
+        update_program.SetUniform(uniforms.emission_spread, spawns.spread, spawns.size);
+        update_program.SetUniform(uniforms.emission_lifetime, spawns.lifetime, spawns.size);
+    }
+
+    gl_state().setEnabled(GL_RASTERIZER_DISCARD, true);
+    gl_state().bindVertexArray(vertex_arrays[current]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[1 - current]);
+
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, GLsizei(capacity));
+    glEndTransformFeedback();
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    gl_state().setEnabled(GL_RASTERIZER_DISCARD, false);
+
+    current = 1 - current;
+
+    if (check_reference) {
+        update_particles_reference(reference, spawns, dt, drag, frame);
+        if (frame % check_interval == 0) {
+            compareWithReference();
+        }
+    }
+
+    frame++;
+}
+
+void ParticleSystem::draw() {
+    gl_state().bindVertexArray(vertex_arrays[current]);
+    glDrawArrays(GL_POINTS, 0, GLsizei(capacity));
+}
+
+void ParticleSystem::setReferenceCheck(bool enabled) {
+    check_reference = enabled;
+    if (!enabled) return;
+
+    // Start from whatever the GPU holds now
+    readback.resize(capacity);
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, buffers[current]);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, capacity * sizeof(GpuParticle), readback.data());
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    reference = readback;
+}
+
+void ParticleSystem::compareWithReference() {
+    // Stalls until the update is done, only meant for testing
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, buffers[current]);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, capacity * sizeof(GpuParticle), readback.data());
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    const auto relative_error = [](float gpu, float cpu) {
+        return std::abs(gpu - cpu) / (1.0f + std::abs(cpu));
+    };
+
+    float error = 0.0f;
+    for (uint32_t i = 0; i < capacity; i++) {
+        const auto& gpu = readback[i];
+        const auto& cpu = reference[i];
+        for (int k = 0; k < 3; k++) {
+            error = std::max(error, relative_error(gpu.position[k], cpu.position[k]));
+            error = std::max(error, relative_error(gpu.velocity[k], cpu.velocity[k]));
+        }
+        error = std::max(error, relative_error(gpu.age, cpu.age));
+        error = std::max(error, relative_error(gpu.lifetime, cpu.lifetime));
+    }
+    worst_error = std::max(worst_error, error);
+    num_checks++;
+
+    if (error > 1e-3f) {
+        std::cerr << "Particle pool differs from the CPU reference by " << error << " at frame " << frame << std::endl;
+    }
+
+    // Rounding differences would otherwise pile up from one check to the next
+    reference = readback;
+}
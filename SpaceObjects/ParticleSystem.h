@@ -0,0 +1,139 @@
+#ifndef SPACEOBJECTS_PARTICLESYSTEM_H
+#define SPACEOBJECTS_PARTICLESYSTEM_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.h"
+
+// One particle as stored in the simulation buffers, in the order transform feedback writes it
+struct GpuParticle {
+    glm::vec3 position;
+    float age;
+    glm::vec3 velocity;
+    float lifetime; // dead once the age reaches it
+};
+
+// Burst of particles born at one point, speeds in units per second
+struct ParticleEmission {
+    glm::vec3 position;
+    glm::vec3 velocity; // shared by the whole burst
+    float spread;       // largest speed added in a random direction
+    float lifetime;     // each particle lives between half of it and all of it
+    uint32_t count;
+};
+
+// Emissions of one update together with the pool slots they overwrite, laid out as the shader uniforms
+struct ParticleSpawns {
+    static constexpr int max_emissions = 16;
+
+    int size = 0;
+    uint32_t start[max_emissions];
+    uint32_t count[max_emissions];
+    glm::vec3 position[max_emissions];
+    glm::vec3 velocity[max_emissions];
+    float spread[max_emissions];
+    float lifetime[max_emissions];
+};
+
+// Engine trails and explosions, simulated either on the GPU or on the CPU
+class ParticleBackend {
+public:
+    virtual ~ParticleBackend() = default;
+
+    virtual void emit(const ParticleEmission& emission) = 0;
+
+    virtual void update(float dt) = 0;
+
+    // Expects the particle render program to be in use
+    virtual void draw() = 0;
+};
+
+// The update of shaders/particle_update_vertex.glsl on the CPU, with the same random numbers.
+// Results differ from the GPU ones by rounding only
+void update_particles_reference(std::vector<GpuParticle>& particles, const ParticleSpawns& spawns,
+                                float dt, float drag, uint32_t frame);
+
+// Particle pool that never leaves GPU memory. An update runs the update program over every slot
+// and captures its outputs into the other of two buffers; new particles take over the slots
+// after the previous emission, wrapping around, so the oldest ones are replaced first
+class ParticleSystem : public ParticleBackend {
+    struct UpdateUniforms {
+        Uniform dt;
+        Uniform drag;
+        Uniform frame;
+        Uniform capacity;
+        Uniform num_emissions;
+        Uniform emission_start;
+        Uniform emission_count;
+        Uniform emission_position;
+        Uniform emission_velocity;
+        Uniform emission_spread;
+        Uniform emission_lifetime;
+
+        explicit UpdateUniforms(const ShaderProgram& program);
+    };
+
+    const ShaderProgram& update_program;
+    UpdateUniforms uniforms;
+
+    uint32_t capacity;
+    GLuint buffers[2];
+    GLuint vertex_arrays[2];
+    int current = 0;
+
+    uint32_t cursor = 0;
+    uint32_t frame = 0;
+    std::deque<ParticleEmission> pending;
+
+    // Mirror of the pool kept by the reference update, compared with the GPU every check_interval frames
+    bool check_reference = false;
+    std::vector<GpuParticle> reference;
+    std::vector<GpuParticle> readback;
+    float worst_error = 0.0f;
+    uint32_t num_checks = 0;
+
+    ParticleSpawns takeSpawns();
+
+    void compareWithReference();
+
+public:
+    static constexpr float drag = 0.8f; // share of the speed lost per second
+    static constexpr uint32_t check_interval = 60;
+
+    // The update program gets its feedback varyings set and is relinked here
+    ParticleSystem(ShaderProgram& update_program, uint32_t capacity);
+
+    ParticleSystem(const ParticleSystem&) = delete;
+    ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+    // Queued until the next update, which takes at most ParticleSpawns::max_emissions of them
+    void emit(const ParticleEmission& emission) override {
+        if (emission.count != 0) pending.push_back(emission);
+    }
+
+    void update(float dt) override;
+
+    // Dead slots are drawn outside the clip volume
+    void draw() override;
+
+    uint32_t getCapacity() const {
+        return capacity;
+    }
+
+    void setReferenceCheck(bool enabled);
+
+    // Largest difference between the GPU pool and the reference over all comparisons so far
+    float referenceError() const {
+        return worst_error;
+    }
+
+    uint32_t numReferenceChecks() const {
+        return num_checks;
+    }
+};
+
+#endif //SPACEOBJECTS_PARTICLESYSTEM_H
@@ -0,0 +1,274 @@
+#include "Picking.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+constexpr uint32_t max_leaf_triangles = 4;
+
+// Moller-Trumbore, both faces count
+bool intersect_triangle(const Ray& ray, const glm::vec3* v, float& t) {
+    const auto edge1 = v[1] - v[0];
+    const auto edge2 = v[2] - v[0];
+
+    const auto p = glm::cross(ray.direction, edge2);
+    const float det = glm::dot(edge1, p);
+    if (glm::abs(det) < 1e-12f) return false;
+
+    const float inv_det = 1.0f / det;
+    const auto s = ray.origin - v[0];
+    const float u = glm::dot(s, p) * inv_det;
+    if (u < 0.0f || u > 1.0f) return false;
+
+    const auto q = glm::cross(s, edge1);
+    const float w = glm::dot(ray.direction, q) * inv_det;
+    if (w < 0.0f || u + w > 1.0f) return false;
+
+    t = glm::dot(edge2, q) * inv_det;
+    return t >= 0.0f;
+}
+
+} // namespace
+
+TriangleBVH::TriangleBVH(const MeshData& mesh) {
+    std::vector<glm::vec3> source;
+    for (const auto& part : mesh.parts) {
+        for (size_t i = 0; i + 2 < part.elements.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                const auto v = part.vertices.data() + 3 * part.elements[i + k];
+                source.emplace_back(v[0], v[1], v[2]);
+            }
+        }
+    }
+
+    const auto num_triangles = uint32_t(source.size() / 3);
+    if (num_triangles == 0) return;
+
+    std::vector<uint32_t> order(num_triangles);
+    std::iota(order.begin(), order.end(), 0u);
+
+    std::vector<glm::vec3> centroids(num_triangles);
+    for (uint32_t i = 0; i < num_triangles; i++) {
+        centroids[i] = (source[3 * i] + source[3 * i + 1] + source[3 * i + 2]) / 3.0f;
+    }
+
+    nodes.reserve(2 * num_triangles / max_leaf_triangles + 1);
+    triangles.reserve(source.size());
+    build(order, centroids, source, 0, num_triangles);
+}
+
+uint32_t TriangleBVH::build(std::vector<uint32_t>& order, std::vector<glm::vec3>& centroids,
+                            const std::vector<glm::vec3>& source, uint32_t begin, uint32_t end) {
+    const auto index = uint32_t(nodes.size());
+    nodes.emplace_back();
+
+    BBox box(source[3 * order[begin]], source[3 * order[begin]]);
+    BBox centroid_box(centroids[order[begin]], centroids[order[begin]]);
+    for (uint32_t i = begin; i < end; i++) {
+        for (int k = 0; k < 3; k++) {
+            const auto& v = source[3 * order[i] + k];
+            box = box.merged(BBox(v, v));
+        }
+        const auto& c = centroids[order[i]];
+        centroid_box = centroid_box.merged(BBox(c, c));
+    }
+
+    const auto extent = centroid_box.max - centroid_box.min;
+    const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    if (end - begin <= max_leaf_triangles || extent[axis] == 0.0f) {
+        nodes[index] = {box, uint32_t(triangles.size() / 3), end - begin};
+        for (uint32_t i = begin; i < end; i++) {
+            for (int k = 0; k < 3; k++) {
+                triangles.push_back(source[3 * order[i] + k]);
+            }
+        }
+        return index;
+    }
+
+    // Median split along the widest centroid axis
+    const auto mid = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                     [&centroids, axis](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+    build(order, centroids, source, begin, mid);
+    const auto right = build(order, centroids, source, mid, end);
+
+    nodes[index] = {box, right, 0};
+    return index;
+}
+
+bool TriangleBVH::raycast(const Ray& ray, float max_t, float& t) const {
+    if (nodes.empty()) return false;
+
+    const auto dir_inverse = 1.0f / ray.direction;
+    bool found = false;
+    t = max_t;
+
+    // Median splits keep the tree depth near log2 of the triangle count
+    uint32_t stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const auto index = stack[--top];
+        const auto& node = nodes[index];
+
+        float box_t;
+        if (!intersect(node.box, ray.origin, dir_inverse, box_t) || box_t >= t) continue;
+
+        if (node.count != 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                float triangle_t;
+                if (intersect_triangle(ray, &triangles[3 * i], triangle_t) && triangle_t < t) {
+                    t = triangle_t;
+                    found = true;
+                }
+            }
+        } else {
+            stack[top++] = node.first;
+            stack[top++] = index + 1;
+        }
+    }
+    return found;
+}
+
+int DynamicBVH::allocateNode() {
+    if (free_list != null_node) {
+        const int node = free_list;
+        free_list = nodes[node].parent;
+        return node;
+    }
+
+    nodes.emplace_back();
+    return int(nodes.size()) - 1;
+}
+
+void DynamicBVH::freeNode(int node) {
+    nodes[node].parent = free_list;
+    free_list = node;
+}
+
+void DynamicBVH::refit(int node) {
+    while (node != null_node) {
+        nodes[node].box = nodes[nodes[node].left].box.merged(nodes[nodes[node].right].box);
+        node = nodes[node].parent;
+    }
+}
+
+void DynamicBVH::insertLeaf(int leaf) {
+    if (root == null_node) {
+        root = leaf;
+        nodes[leaf].parent = null_node;
+        return;
+    }
+
+    // Walk down to the sibling that increases the total surface area the least
+    const auto leaf_box = nodes[leaf].box;
+    int sibling = root;
+    while (!nodes[sibling].isLeaf()) {
+        const auto& node = nodes[sibling];
+
+        const float area = node.box.surfaceArea();
+        const float combined_area = node.box.merged(leaf_box).surfaceArea();
+
+        // Cost of pairing with this node, and the growth pushed down to its children otherwise
+        const float cost = 2.0f * combined_area;
+        const float inheritance_cost = 2.0f * (combined_area - area);
+
+        const auto child_cost = [&](int child) {
+            const auto& child_box = nodes[child].box;
+            const float merged_area = child_box.merged(leaf_box).surfaceArea();
+            const float own_area = nodes[child].isLeaf() ? 0.0f : child_box.surfaceArea();
+            return merged_area - own_area + inheritance_cost;
+        };
+        const float cost_left = child_cost(node.left);
+        const float cost_right = child_cost(node.right);
+
+        if (cost < cost_left && cost < cost_right) break;
+        sibling = cost_left < cost_right ? node.left : node.right;
+    }
+
+    const int old_parent = nodes[sibling].parent;
+    const int new_parent = allocateNode();
+
+    nodes[new_parent].parent = old_parent;
+    nodes[new_parent].box = nodes[sibling].box.merged(leaf_box);
+    nodes[new_parent].left = sibling;
+    nodes[new_parent].right = leaf;
+    nodes[new_parent].id = 0;
+
+    nodes[sibling].parent = new_parent;
+    nodes[leaf].parent = new_parent;
+
+    if (old_parent == null_node) {
+        root = new_parent;
+    } else {
+        if (nodes[old_parent].left == sibling) {
+            nodes[old_parent].left = new_parent;
+        } else {
+            nodes[old_parent].right = new_parent;
+        }
+        refit(old_parent);
+    }
+}
+
+void DynamicBVH::removeLeaf(int leaf) {
+    if (leaf == root) {
+        root = null_node;
+        return;
+    }
+
+    const int parent = nodes[leaf].parent;
+    const int grand_parent = nodes[parent].parent;
+    const int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+    if (grand_parent == null_node) {
+        root = sibling;
+        nodes[sibling].parent = null_node;
+    } else {
+        if (nodes[grand_parent].left == parent) {
+            nodes[grand_parent].left = sibling;
+        } else {
+            nodes[grand_parent].right = sibling;
+        }
+        nodes[sibling].parent = grand_parent;
+        refit(grand_parent);
+    }
+
+    freeNode(parent);
+}
+
+void DynamicBVH::insert(Id id, const BBox& box) {
+    remove(id);
+
+    const int leaf = allocateNode();
+    nodes[leaf].box = BBox(box.min - glm::vec3(margin), box.max + glm::vec3(margin));
+    nodes[leaf].left = null_node;
+    nodes[leaf].right = null_node;
+    nodes[leaf].id = id;
+    leaves[id] = leaf;
+
+    insertLeaf(leaf);
+}
+
+void DynamicBVH::update(Id id, const BBox& box) {
+    const auto it = leaves.find(id);
+    if (it == leaves.end()) return;
+
+    const int leaf = it->second;
+    if (nodes[leaf].box.contains(box)) return;
+
+    removeLeaf(leaf);
+    nodes[leaf].box = BBox(box.min - glm::vec3(margin), box.max + glm::vec3(margin));
+    insertLeaf(leaf);
+}
+
+void DynamicBVH::remove(Id id) {
+    const auto it = leaves.find(id);
+    if (it == leaves.end()) return;
+
+    removeLeaf(it->second);
+    freeNode(it->second);
+    leaves.erase(it);
+}
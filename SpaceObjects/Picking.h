@@ -0,0 +1,148 @@
+#ifndef SPACEOBJECTS_PICKING_H
+#define SPACEOBJECTS_PICKING_H
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "BBox.h"
+#include "MeshData.h"
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction; // not necessarily normalized, distances are in units of its length
+
+    // Ray through a window pixel, origin on the near plane
+    static Ray fromCursor(double xpos, double ypos, const glm::mat4& inverse_view_projection, float width, float height) {
+        const float x = float(2.0 * xpos / width - 1.0);
+        const float y = float(1.0 - 2.0 * ypos / height);
+
+        const auto near = inverse_view_projection * glm::vec4(x, y, -1.0f, 1.0f);
+        const auto far = inverse_view_projection * glm::vec4(x, y, 1.0f, 1.0f);
+
+        const glm::vec3 origin = glm::vec3(near) / near.w;
+        return {origin, glm::vec3(far) / far.w - origin};
+    }
+
+    Ray transformed(const glm::mat4& transform) const {
+        return {glm::vec3(transform * glm::vec4(origin, 1.0f)), glm::vec3(transform * glm::vec4(direction, 0.0f))};
+    }
+};
+
+// Static BVH over the triangles of a mesh, in model space
+class TriangleBVH {
+    struct Node {
+        BBox box;
+        uint32_t first;  // leaf: first triangle, inner: index of the right child (left child follows the node)
+        uint32_t count;  // number of triangles, 0 for inner nodes
+    };
+
+    std::vector<Node> nodes;
+    std::vector<glm::vec3> triangles; // three vertices per triangle, in leaf order
+
+    uint32_t build(std::vector<uint32_t>& order, std::vector<glm::vec3>& centroids,
+                   const std::vector<glm::vec3>& source, uint32_t begin, uint32_t end);
+
+public:
+    TriangleBVH() = default;
+
+    explicit TriangleBVH(const MeshData& mesh);
+
+    bool empty() const {
+        return nodes.empty();
+    }
+
+    // Nearest hit closer than max_t
+    bool raycast(const Ray& ray, float max_t, float& t) const;
+};
+
+// Dynamic AABB tree over world-space entity boxes. Leaves store slightly inflated boxes,
+// so small movements do not restructure the tree
+class DynamicBVH {
+public:
+    typedef uint32_t Id;
+
+private:
+    static const int null_node = -1;
+
+    struct Node {
+        BBox box;
+        int parent; // next free node while the node is unused
+        int left;
+        int right;
+        Id id;
+
+        bool isLeaf() const {
+            return left == null_node;
+        }
+    };
+
+    std::vector<Node> nodes;
+    std::unordered_map<Id, int> leaves;
+    int root = null_node;
+    int free_list = null_node;
+    float margin;
+
+    int allocateNode();
+
+    void freeNode(int node);
+
+    void insertLeaf(int leaf);
+
+    void removeLeaf(int leaf);
+
+    void refit(int node);
+
+public:
+    explicit DynamicBVH(float margin = 1.0f) : margin(margin) {}
+
+    void insert(Id id, const BBox& box);
+
+    void update(Id id, const BBox& box);
+
+    // Does nothing for unknown ids
+    void remove(Id id);
+
+    size_t size() const {
+        return leaves.size();
+    }
+
+    // Nearest entity hit by the ray. For every leaf whose box is closer than the best hit so far
+    // refine(id, ray, t) is called with t set to the box entry distance; it may reject the leaf
+    // or tighten t with an exact test
+    template <typename Refine>
+    bool raycast(const Ray& ray, Refine refine, Id& hit_id, float& hit_t) const {
+        if (root == null_node) return false;
+
+        const auto dir_inverse = 1.0f / ray.direction;
+        bool found = false;
+        hit_t = INFINITY;
+
+        std::vector<int> stack;
+        stack.reserve(64);
+        stack.push_back(root);
+        while (!stack.empty()) {
+            const auto& node = nodes[stack.back()];
+            stack.pop_back();
+
+            float t;
+            if (!intersect(node.box, ray.origin, dir_inverse, t) || t >= hit_t) continue;
+
+            if (node.isLeaf()) {
+                if (refine(node.id, ray, t) && t < hit_t) {
+                    hit_t = t;
+                    hit_id = node.id;
+                    found = true;
+                }
+            } else {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+            }
+        }
+        return found;
+    }
+};
+
+#endif //SPACEOBJECTS_PICKING_H
@@ -0,0 +1,134 @@
+#include "RenderQueue.h"
+#include "GLState.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr float MAX_DEPTH = 1024.0f;
+constexpr uint64_t DEPTH_STEPS = (1u << 20) - 1;
+
+// Names that differ from every real one, so the first bind of a frame is never skipped
+constexpr GLuint UNKNOWN_NAME = ~0u;
+
+bool is_blended(RenderPass pass) {
+    return pass == RenderPass::EXPLOSIONS || pass == RenderPass::PARTICLES;
+}
+
+} // namespace
+
+RenderStats& RenderStats::operator+=(const RenderStats& other) {
+    packets += other.packets;
+    program_switches += other.program_switches;
+    texture_binds += other.texture_binds;
+    vertex_array_binds += other.vertex_array_binds;
+    skipped_binds += other.skipped_binds;
+    custom_draws += other.custom_draws;
+    return *this;
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, const ShaderProgram& program, GLuint texture, GLuint vertex_array, float depth) {
+    const auto depth_bits = uint64_t(std::min(std::max(depth / MAX_DEPTH, 0.0f), 1.0f) * DEPTH_STEPS);
+
+    // Names are small integers in practice; a collision only costs a redundant bind
+    const auto state_bits = uint64_t(program.GetProgram() & 0xffu) << 32
+                          | uint64_t(texture & 0xffffu) << 16
+                          | uint64_t(vertex_array & 0xffffu);
+
+    // Blended draws have to be composited far to near whatever state they use, state only
+    // groups draws at the same depth
+    if (is_blended(pass)) {
+        return uint64_t(pass) << 60 | (DEPTH_STEPS - depth_bits) << 40 | state_bits;
+    }
+    return uint64_t(pass) << 60 | state_bits << 20 | depth_bits;
+}
+
+void RenderQueue::applyPassState(RenderPass pass) {
+    gl_state().depthMask(pass != RenderPass::SKY && pass != RenderPass::PARTICLES);
+
+    if (pass == RenderPass::PARTICLES) {
+        gl_state().blendFunc(GL_SRC_ALPHA, GL_ONE);
+    } else {
+        gl_state().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+}
+
+void RenderQueue::execute() {
+    std::stable_sort(packets.begin(), packets.end(), [](const DrawPacket& first, const DrawPacket& second) {
+        return first.key < second.key;
+    });
+
+    RenderStats stats;
+    stats.packets = int(packets.size());
+
+    int pass = -1;
+    const ShaderProgram* program = nullptr;
+    GLuint texture = UNKNOWN_NAME;
+    GLuint vertex_array = UNKNOWN_NAME;
+
+    for (const auto& packet : packets) {
+        const auto packet_pass = int(packet.key >> 60);
+        if (packet_pass != pass) {
+            pass = packet_pass;
+            applyPassState(RenderPass(pass));
+        }
+
+        if (packet.program != program) {
+            program = packet.program;
+            program->StartUseShader();
+            stats.program_switches++;
+
+            for (auto& uniforms : frame_uniforms) {
+                if (uniforms.program == program && !uniforms.applied) {
+                    uniforms.set_uniforms(*program, uniforms.data);
+                    uniforms.applied = true;
+                }
+            }
+        } else {
+            stats.skipped_binds++;
+        }
+
+        if (packet.set_uniforms != nullptr) {
+            packet.set_uniforms(*program, packet.uniform_data);
+        }
+
+        if (packet.custom_draw != nullptr) {
+            packet.custom_draw(packet.draw_data);
+            stats.custom_draws++;
+
+            // Whatever it left bound is unknown
+            texture = UNKNOWN_NAME;
+            vertex_array = UNKNOWN_NAME;
+            continue;
+        }
+
+        if (packet.texture != texture) {
+            texture = packet.texture;
+            gl_state().bindTexture(GL_TEXTURE0, packet.texture_target, texture);
+            stats.texture_binds++;
+        } else {
+            stats.skipped_binds++;
+        }
+
+        if (packet.vertex_array != vertex_array) {
+            vertex_array = packet.vertex_array;
+            gl_state().bindVertexArray(vertex_array);
+            stats.vertex_array_binds++;
+        } else {
+            stats.skipped_binds++;
+        }
+
+        const auto index_size = packet.index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        glDrawElementsInstanced(GL_TRIANGLES, packet.num_elements, packet.index_type,
+                                reinterpret_cast<const void*>(packet.first_element * index_size), packet.instances);
+    }
+
+    applyPassState(RenderPass::MESHES);
+
+    packets.clear();
+    frame_uniforms.clear();
+
+    last_stats = stats;
+    total_stats += stats;
+    frames++;
+}
@@ -0,0 +1,122 @@
+#ifndef SPACEOBJECTS_RENDERQUEUE_H
+#define SPACEOBJECTS_RENDERQUEUE_H
+
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+
+#include "ShaderProgram.h"
+
+// Passes in drawing order. Each pass has fixed depth and blend state
+enum class RenderPass : uint8_t {
+    SKY,        // no depth writes
+    STARFIELD,
+    MESHES,
+    IMPOSTORS,
+    EXPLOSIONS, // blended, back to front
+    PARTICLES,  // additive, no depth writes, back to front
+    EFFECTS,
+    HUD,
+};
+
+// GL state changes issued by the queue during one frame
+struct RenderStats {
+    int packets = 0;
+    int program_switches = 0;
+    int texture_binds = 0;
+    int vertex_array_binds = 0;
+    int skipped_binds = 0; // program, texture or vertex array already bound
+    int custom_draws = 0;  // their own binds are not counted
+
+    RenderStats& operator+=(const RenderStats& other);
+};
+
+// Sets uniforms of the program in use from data, which has to outlive RenderQueue::execute()
+typedef void (*UniformSetter)(const ShaderProgram& program, const void* data);
+
+struct DrawPacket {
+    uint64_t key;
+    const ShaderProgram* program;
+
+    // Per-draw uniforms, optional
+    UniformSetter set_uniforms = nullptr;
+    const void* uniform_data = nullptr;
+
+    // Instanced GL_TRIANGLES; texture goes to unit 0
+    GLenum texture_target = GL_TEXTURE_2D;
+    GLuint texture = 0;
+    GLuint vertex_array = 0;
+    GLenum index_type = GL_UNSIGNED_INT;
+    GLsizei first_element = 0;
+    GLsizei num_elements = 0;
+    GLsizei instances = 1;
+
+    // Draws that bind their own buffers (streamed geometry, text) replace the indexed draw with this
+    void (*custom_draw)(void* data) = nullptr;
+    void* draw_data = nullptr;
+};
+
+// Draws of a frame sorted by a 64-bit key, so that packets sharing a program, texture or mesh
+// end up next to each other and the binds between them can be skipped.
+// Key bits, most significant first: pass (4), program (8), texture (16), mesh (16), depth (20).
+// Blended passes put depth right below the pass instead, so they sort back to front before by state
+class RenderQueue {
+    struct FrameUniforms {
+        const ShaderProgram* program;
+        UniformSetter set_uniforms;
+        const void* data;
+        bool applied;
+    };
+
+    std::vector<DrawPacket> packets;
+    std::vector<FrameUniforms> frame_uniforms;
+
+    RenderStats last_stats;
+    RenderStats total_stats;
+    int frames = 0;
+
+    static void applyPassState(RenderPass pass);
+
+public:
+    // Depth is the distance from the camera; blended passes invert it to draw back to front
+    static uint64_t makeKey(RenderPass pass, const ShaderProgram& program, GLuint texture, GLuint vertex_array, float depth);
+
+    // Applied once per frame when the program is first bound, e.g. the view-projection matrix
+    void setFrameUniforms(const ShaderProgram& program, UniformSetter set_uniforms, const void* data) {
+        frame_uniforms.push_back({&program, set_uniforms, data, false});
+    }
+
+    void submit(const DrawPacket& packet) {
+        packets.push_back(packet);
+    }
+
+    // Object with a draw() of its own, called once the program is in use
+    template <typename T>
+    void submitDraw(RenderPass pass, const ShaderProgram& program, T& object) {
+        DrawPacket packet;
+        packet.key = makeKey(pass, program, 0, 0, 0.0f);
+        packet.program = &program;
+        packet.custom_draw = [](void* data) { static_cast<T*>(data)->draw(); };
+        packet.draw_data = &object;
+        submit(packet);
+    }
+
+    // Sorts and draws everything submitted since the last call. Packets with equal keys keep
+    // their submission order. Bindings of the last packet stay in place
+    void execute();
+
+    const RenderStats& lastFrameStats() const {
+        return last_stats;
+    }
+
+    // Sums over all executed frames
+    const RenderStats& totalStats() const {
+        return total_stats;
+    }
+
+    int numFrames() const {
+        return frames;
+    }
+};
+
+#endif //SPACEOBJECTS_RENDERQUEUE_H
@@ -1,4 +1,7 @@
 #include "ShaderProgram.h"
+#include "GLState.h"
+
+#include <vector>
 
 ShaderProgram::ShaderProgram(const std::unordered_map<GLenum, std::string> &inputShaders)
 {
@@ -51,8 +54,10 @@ ShaderProgram::ShaderProgram(const std::unordered_map<GLenum, std::string> &inpu
     glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
     std::cerr << "Shader program linking failed\n" << infoLog << std::endl;
     shaderProgram = 0;
+    return;
   }
 
+  CacheUniforms();
 }
 
 
@@ -93,7 +98,7 @@ void ShaderProgram::Release()
     glDeleteShader(shaderObjects[GL_COMPUTE_SHADER]);
   }
 
-  glDeleteProgram(shaderProgram);
+  gl_state().deleteProgram(shaderProgram);
 }
 
 bool ShaderProgram::reLink()
@@ -118,9 +123,62 @@ bool ShaderProgram::reLink()
     return false;
   }
 
+  CacheUniforms();
   return true;
 }
 
+bool ShaderProgram::SetFeedbackVaryings(const std::vector<std::string> &varyings)
+{
+  std::vector<const GLchar *> names;
+  for (const auto &varying : varyings)
+    names.push_back(varying.c_str());
+
+  glTransformFeedbackVaryings(shaderProgram, GLsizei(names.size()), names.data(), GL_INTERLEAVED_ATTRIBS);
+  return reLink();
+}
+
+void ShaderProgram::CacheUniforms()
+{
+  uniformLocations.clear();
+
+  GLint numUniforms = 0;
+  GLint maxNameLength = 0;
+  glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORMS, &numUniforms);
+  glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+  std::vector<GLchar> nameBuffer(maxNameLength + 1);
+  for (GLint i = 0; i < numUniforms; i++)
+  {
+    GLsizei nameLength;
+    GLint size;
+    GLenum type;
+    glGetActiveUniform(shaderProgram, GLuint(i), GLsizei(nameBuffer.size()), &nameLength, &size, &type, nameBuffer.data());
+
+    const std::string name(nameBuffer.data(), nameLength);
+    const GLint location = glGetUniformLocation(shaderProgram, name.c_str());
+    if (location == -1)
+      continue; // member of a uniform block
+
+    uniformLocations[name] = location;
+
+    // Arrays are reported as "name[0]", make plain "name" resolve too
+    const auto bracket = name.find('[');
+    if (bracket != std::string::npos)
+      uniformLocations[name.substr(0, bracket)] = location;
+  }
+}
+
+Uniform ShaderProgram::GetUniform(const std::string &name) const
+{
+  const auto it = uniformLocations.find(name);
+  if (it == uniformLocations.end())
+  {
+    std::cerr << "Uniform  " << name << " not found" << std::endl;
+    return Uniform();
+  }
+  return Uniform(it->second);
+}
+
 
 GLuint ShaderProgram::LoadShaderObject(GLenum type, const std::string &filename)
 {
@@ -157,94 +215,106 @@ GLuint ShaderProgram::LoadShaderObject(GLenum type, const std::string &filename)
 
 void ShaderProgram::StartUseShader() const
 {
-  glUseProgram(shaderProgram);
+  gl_state().useProgram(shaderProgram);
 }
 
 void ShaderProgram::StopUseShader() const
 {
-  glUseProgram(0);
+  gl_state().useProgram(0);
 }
 
 void ShaderProgram::SetUniform(const std::string &location, int value) const
 {
-  GLint uniformLocation = glGetUniformLocation(shaderProgram, location.c_str());
-  if (uniformLocation == -1)
-  {
-    std::cerr << "Uniform  " << location << " not found" << std::endl;
-    return;
-  }
-  glUniform1i(uniformLocation, value);
+  SetUniform(GetUniform(location), value);
 }
 
 void ShaderProgram::SetUniform(const std::string &location, unsigned int value) const
 {
-  GLint uniformLocation = glGetUniformLocation(shaderProgram, location.c_str());
-  if (uniformLocation == -1)
-  {
-    std::cerr << "Uniform  " << location << " not found" << std::endl;
-    return;
-  }
-  glUniform1ui(uniformLocation, value);
+  SetUniform(GetUniform(location), value);
 }
 
 void ShaderProgram::SetUniform(const std::string &location, float value) const
 {
-  GLint uniformLocation = glGetUniformLocation(shaderProgram, location.c_str());
-  if (uniformLocation == -1)
-  {
-    std::cerr << "Uniform  " << location << " not found" << std::endl;
-    return;
-  }
-  glUniform1f(uniformLocation, value);
+  SetUniform(GetUniform(location), value);
 }
 
 void ShaderProgram::SetUniform(const std::string &location, double value) const
 {
-  GLint uniformLocation = glGetUniformLocation(shaderProgram, location.c_str());
-  if (uniformLocation == -1)
-  {
-    std::cerr << "Uniform  " << location << " not found" << std::endl;
-    return;
-  }
-  glUniform1d(uniformLocation, value);
+  SetUniform(GetUniform(location), value);
 }
 
-void ShaderProgram::SetUniform(const std::string &location, const glm::mat4 &m4) const {
-  GLint uniformLocation = glGetUniformLocation(shaderProgram, location.c_str());
-  if (uniformLocation == -1)
-  {
-    std::cerr << "Uniform  " << location << " not found" << std::endl;
-    return;
-  }
-  glUniformMatrix4fv(uniformLocation, 1, GL_FALSE, glm::value_ptr(m4));
-}
-
-void ShaderProgram::SetUniform(const std::string &location, const glm::vec4 &v4) const {
-    GLint uniformLocation = glGetUniformLocation(shaderProgram, location.c_str());
-    if (uniformLocation == -1)
-    {
-        std::cerr << "Uniform  " << location << " not found" << std::endl;
-        return;
-    }
-    glUniform4fv(uniformLocation, 1, glm::value_ptr(v4));
-}
-
-void ShaderProgram::SetUniform(const std::string &location, const glm::vec3 &v3) const {
-    GLint uniformLocation = glGetUniformLocation(shaderProgram, location.c_str());
-    if (uniformLocation == -1)
-    {
-        std::cerr << "Uniform  " << location << " not found" << std::endl;
-        return;
-    }
-    glUniform3fv(uniformLocation, 1, glm::value_ptr(v3));
-}
-
-void ShaderProgram::SetUniform(const std::string &location, const glm::vec2 &v2) const {
-    GLint uniformLocation = glGetUniformLocation(shaderProgram, location.c_str());
-    if (uniformLocation == -1)
-    {
-        std::cerr << "Uniform  " << location << " not found" << std::endl;
-        return;
-    }
-    glUniform2fv(uniformLocation, 1, glm::value_ptr(v2));
+void ShaderProgram::SetUniform(const std::string &location, const glm::mat4 &m4) const
+{
+  SetUniform(GetUniform(location), m4);
+}
+
+void ShaderProgram::SetUniform(const std::string &location, const glm::vec4 &v4) const
+{
+  SetUniform(GetUniform(location), v4);
+}
+
+void ShaderProgram::SetUniform(const std::string &location, const glm::vec3 &v3) const
+{
+  SetUniform(GetUniform(location), v3);
+}
+
+void ShaderProgram::SetUniform(const std::string &location, const glm::vec2 &v2) const
+{
+  SetUniform(GetUniform(location), v2);
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, int value) const
+{
+  // Location -1 is silently ignored by GL, same as a missing uniform
+  glUniform1i(uniform.location, value);
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, unsigned int value) const
+{
+  glUniform1ui(uniform.location, value);
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, float value) const
+{
+  glUniform1f(uniform.location, value);
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, double value) const
+{
+  glUniform1d(uniform.location, value);
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, const glm::mat4 &m4) const
+{
+  glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(m4));
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, const glm::vec4 &v4) const
+{
+  glUniform4fv(uniform.location, 1, glm::value_ptr(v4));
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, const glm::vec3 &v3) const
+{
+  glUniform3fv(uniform.location, 1, glm::value_ptr(v3));
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, const glm::vec2 &v2) const
+{
+  glUniform2fv(uniform.location, 1, glm::value_ptr(v2));
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, const float *values, GLsizei count) const
+{
+  glUniform1fv(uniform.location, count, values);
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, const unsigned int *values, GLsizei count) const
+{
+  glUniform1uiv(uniform.location, count, values);
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, const glm::vec3 *values, GLsizei count) const
+{
+  glUniform3fv(uniform.location, count, glm::value_ptr(values[0]));
 }
@@ -2,11 +2,22 @@
 #define SHADERPROGRAM_H
 
 #include <unordered_map>
+#include <vector>
 #include "common.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 
+// Uniform location resolved once at link time
+struct Uniform
+{
+  GLint location;
+
+  Uniform() : location(-1) {}
+
+  explicit Uniform(GLint location) : location(location) {}
+};
+
 class ShaderProgram
 {
 public:
@@ -28,6 +39,12 @@ public:
 
   bool reLink();
 
+  // Captures the given vertex shader outputs into one interleaved buffer, relinks the program
+  bool SetFeedbackVaryings(const std::vector<std::string> &varyings);
+
+  // Lookup in the table filled at link time, no GL calls involved
+  Uniform GetUniform(const std::string &name) const;
+
   void SetUniform(const std::string &location, float value) const;
 
   void SetUniform(const std::string &location, double value) const;
@@ -44,12 +61,39 @@ public:
 
   void SetUniform(const std::string &location, const glm::vec4& v4) const;
 
+  void SetUniform(Uniform uniform, float value) const;
+
+  void SetUniform(Uniform uniform, double value) const;
+
+  void SetUniform(Uniform uniform, int value) const;
+
+  void SetUniform(Uniform uniform, unsigned int value) const;
+
+  void SetUniform(Uniform uniform, const glm::mat4& m4) const;
+
+  void SetUniform(Uniform uniform, const glm::vec2& v2) const;
+
+  void SetUniform(Uniform uniform, const glm::vec3& v3) const;
+
+  void SetUniform(Uniform uniform, const glm::vec4& v4) const;
+
+  // Uniform arrays, the uniform is the location of the first element
+
+  void SetUniform(Uniform uniform, const float *values, GLsizei count) const;
+
+  void SetUniform(Uniform uniform, const unsigned int *values, GLsizei count) const;
+
+  void SetUniform(Uniform uniform, const glm::vec3 *values, GLsizei count) const;
+
 
 private:
   static GLuint LoadShaderObject(GLenum type, const std::string &filename);
 
+  void CacheUniforms();
+
   GLuint shaderProgram;
   std::unordered_map<GLenum, GLuint> shaderObjects;
+  std::unordered_map<std::string, GLint> uniformLocations;
 };
 
 
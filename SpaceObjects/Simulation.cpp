@@ -0,0 +1,189 @@
+#include "Simulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+// Milliseconds since the previous lap
+double lap_ms(std::chrono::steady_clock::time_point& lap_start) {
+    const auto now = std::chrono::steady_clock::now();
+    const auto ms = std::chrono::duration<double, std::milli>(now - lap_start).count();
+    lap_start = now;
+    return ms;
+}
+
+} // namespace
+
+constexpr double Simulation::tick_rate;
+constexpr double Simulation::dt;
+constexpr int Simulation::laser_recharge_rate;
+constexpr int Simulation::death_frames;
+
+Simulation::Simulation(const ModelFactory& model_factory) :
+    model_factory(model_factory),
+    main_ship(model_factory.get_model(ModelName::E45_AIRCRAFT)),
+    collisions(32.0f) {
+
+    main_ship.id = EntityStore::null_handle;
+    collisions.insert(main_ship.id, unsigned(CollisionLayer::SHIP), main_ship.getBBox());
+
+    previous_ship_position = main_ship.world_pos;
+}
+
+void Simulation::spawn(const ModelInstance& model, const glm::vec3& velocity, CollisionLayer layer) {
+    const auto allocs_before = AllocCounter::snapshot();
+
+    const auto handle = entities.spawn(model, velocity, unsigned(layer));
+    if (handle != EntityStore::null_handle) {
+        const auto box = entities.bbox(entities.indexOf(handle));
+        collisions.insert(handle, unsigned(layer), box);
+        targets.insert(handle, box);
+    }
+
+    spawn_allocs += AllocCounter::snapshot() - allocs_before;
+    spawn_count++;
+}
+
+void Simulation::untrack(EntityStore::Handle handle) {
+    collisions.remove(handle);
+    targets.remove(handle);
+}
+
+void Simulation::kill(size_t i) {
+    entities.dying[i] = 1;
+    untrack(entities.handle[i]);
+
+    const glm::vec3 velocity(entities.vel_x[i], entities.vel_y[i], entities.vel_z[i]);
+    explosions.push_back({entities.position(i), float(speed_multiplier * tick_rate) * velocity});
+}
+
+void Simulation::shoot(const Ray& aim) {
+    DynamicBVH::Id target;
+    float hit_t;
+    const auto hit_mesh = [this](DynamicBVH::Id id, const Ray& ray, float& t) {
+        const auto i = entities.indexOf(id);
+        const auto local_ray = ray.transformed(glm::inverse(entities.worldTransform(i)));
+        return entities.asset[i]->triangles.raycast(local_ray, INFINITY, t);
+    };
+
+    if (targets.raycast(aim, hit_mesh, target, hit_t)) {
+        const auto i = entities.indexOf(target);
+
+        laser_dst = aim.origin + hit_t * aim.direction;
+        kill(i);
+        score += entities.damage[i];
+    } else {
+        // Missed, the laser goes to the far plane
+        laser_dst = aim.origin + aim.direction;
+    }
+}
+
+void Simulation::tick(const TickInput& input) {
+    const auto tick_start = std::chrono::steady_clock::now();
+    auto lap_start = tick_start;
+
+    previous_camera_position = camera_position;
+    previous_ship_position = main_ship.world_pos;
+
+    smooth_step += 0.05f * (input.step - smooth_step);
+    camera_shift = smooth_step;
+    camera_position += camera_shift;
+
+    // Check laser status
+    if (laser_recharge != 0) {
+        laser_recharge--;
+        laser_dst += enemies_speed + camera_shift;
+    } else if (input.shoot && !main_ship.dead) {
+        laser_recharge = laser_recharge_rate;
+        shoot(input.aim);
+    }
+    timings.laser_ms += lap_ms(lap_start);
+
+    // Move everything, then drop what has exploded or flown past the camera
+    entities.integrate(speed_multiplier);
+    timings.integrate_ms += lap_ms(lap_start);
+
+    // Walk backwards so that swap-and-pop removal only brings in entities already visited
+    for (size_t i = entities.size(); i-- > 0;) {
+        const auto handle = entities.handle[i];
+
+        if (entities.dying[i]) {
+            if (entities.death_countdown[i] <= 0) {
+                entities.remove(handle);
+            }
+            continue;
+        }
+
+        if (entities.pos_z[i] > 200.0f) {
+            untrack(handle);
+            entities.remove(handle);
+            continue;
+        }
+
+        // Enemies shoot
+        if (entities.kind[i] == unsigned(CollisionLayer::ENEMY) && rand() % 1000 == 0) {
+            const auto position = entities.position(i);
+            const Asteroid rocket(model_factory.get_model(ModelName::ROCKET, position),
+                speed_multiplier * 2.0f * glm::normalize(main_ship.world_pos - position));
+            spawn(rocket, rocket.velocity, CollisionLayer::ROCKET);
+        }
+    }
+    timings.entities_ms += lap_ms(lap_start);
+
+    // Enemies spawn
+    if (rand() % 300 == 0) {
+        auto enemy = model_factory.get_random_enemy(camera_position);
+        enemy.damage = 50.0f;
+        spawn(enemy, enemies_speed, CollisionLayer::ENEMY);
+    }
+
+    // Asteroids spawn
+    if (rand() % 300 == 0) {
+        auto asteroid = model_factory.get_random_asteroid(camera_position, main_ship.world_pos);
+        asteroid.damage = 25.0f;
+        spawn(asteroid, asteroid.velocity, CollisionLayer::ASTEROID);
+    }
+    timings.spawn_ms += lap_ms(lap_start);
+
+    for (size_t i = 0; i < entities.size(); i++) {
+        if (entities.dying[i]) continue;
+
+        const auto box = entities.bbox(i);
+        collisions.update(entities.handle[i], box);
+        targets.update(entities.handle[i], box);
+    }
+
+    main_ship.move(camera_shift);
+    collisions.update(main_ship.id, main_ship.getBBox());
+    timings.broadphase_ms += lap_ms(lap_start);
+
+    // Collide the ship with everything that is still alive
+    hits.clear();
+    for (const auto layer : {CollisionLayer::ENEMY, CollisionLayer::ASTEROID, CollisionLayer::ROCKET}) {
+        collisions.queryPairs(unsigned(CollisionLayer::SHIP), unsigned(layer), [this](CollisionWorld::Id, CollisionWorld::Id other) {
+            hits.push_back(other);
+        });
+    }
+    for (const auto handle : hits) {
+        const auto i = entities.indexOf(handle);
+        main_ship_hp = std::max(main_ship_hp - entities.damage[i], 0.0f);
+        kill(i);
+    }
+    timings.collide_ms += lap_ms(lap_start);
+
+    if (main_ship_hp == 0.0f) {
+        main_ship.dead = true;
+    }
+    if (main_ship.dead && main_ship.death_countdown > 0) {
+        main_ship.die();
+    }
+
+    particles_state += speed_multiplier * enemies_speed;
+
+    speed_multiplier += 0.0001f;
+
+    ticks++;
+    tick_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - tick_start).count();
+}
@@ -0,0 +1,124 @@
+#ifndef SPACEOBJECTS_SIMULATION_H
+#define SPACEOBJECTS_SIMULATION_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "AllocCounter.h"
+#include "Collision.h"
+#include "EntityStore.h"
+#include "ModelFactories.h"
+#include "Picking.h"
+
+enum class CollisionLayer : unsigned {
+    SHIP,
+    ENEMY,
+    ASTEROID,
+    ROCKET,
+};
+
+// Player input sampled for one tick
+struct TickInput {
+    glm::vec3 step = glm::vec3(0.0f); // desired camera movement per tick
+    bool shoot = false;
+    Ray aim;                          // world-space ray under the crosshair, used when shooting
+};
+
+// Wall time spent in each stage of tick(), summed over all ticks
+struct TickTimings {
+    double laser_ms = 0.0;      // recharge and picking
+    double integrate_ms = 0.0;
+    double entities_ms = 0.0;   // culling, explosions, enemy fire
+    double spawn_ms = 0.0;
+    double broadphase_ms = 0.0; // collision grid and picking tree updates
+    double collide_ms = 0.0;
+};
+
+// Entity killed during a tick, for effects that outlive it
+struct Explosion {
+    glm::vec3 position;
+    glm::vec3 velocity; // units per second
+};
+
+// Game logic advanced in fixed steps, independent of how often frames are drawn.
+// All speeds, rates and countdowns are per tick
+class Simulation {
+public:
+    static constexpr double tick_rate = 60.0;
+    static constexpr double dt = 1.0 / tick_rate;
+
+    static constexpr int laser_recharge_rate = 15;
+    static constexpr int death_frames = 60;
+
+    const ModelFactory& model_factory;
+
+    // Enemies, asteroids and rockets, tagged with their collision layer
+    EntityStore entities;
+
+    ModelInstance main_ship;
+    float main_ship_hp = 100.0f;
+    int score = 0;
+
+    glm::vec3 camera_position = glm::vec3(0.0f);
+    glm::vec3 camera_shift = glm::vec3(0.0f); // camera movement of the last tick
+
+    glm::vec3 enemies_speed = glm::vec3(0.0f, 0.0f, 0.5f);
+    glm::vec3 particles_state = glm::vec3(0.0f);
+    float speed_multiplier = 1.0f;
+
+    int laser_recharge = 0;
+    glm::vec3 laser_dst = glm::vec3(0.0f);
+
+    // Appended by every tick, the consumer clears it
+    std::vector<Explosion> explosions;
+
+    uint64_t ticks = 0;
+    double tick_seconds = 0.0; // wall time spent inside tick()
+    TickTimings timings;
+
+    // Heap traffic caused by spawning, should not depend on the size of the spawned mesh
+    AllocCounter spawn_allocs {0, 0};
+    int spawn_count = 0;
+
+private:
+    // Live entities are kept in the collision world until they die or leave the scene,
+    // everything but the ship can also be shot. Entity handles double as collision ids
+    CollisionWorld collisions;
+    DynamicBVH targets;
+    std::vector<CollisionWorld::Id> hits;
+
+    glm::vec3 smooth_step = glm::vec3(0.0f);
+    glm::vec3 previous_camera_position = glm::vec3(0.0f);
+    glm::vec3 previous_ship_position = glm::vec3(0.0f);
+
+    void spawn(const ModelInstance& model, const glm::vec3& velocity, CollisionLayer layer);
+
+    void untrack(EntityStore::Handle handle);
+
+    // Starts the death countdown of entity i
+    void kill(size_t i);
+
+    void shoot(const Ray& aim);
+
+public:
+    explicit Simulation(const ModelFactory& model_factory);
+
+    void tick(const TickInput& input);
+
+    // Render state alpha of the way from the previous tick to the current one
+
+    glm::vec3 cameraPosition(float alpha) const {
+        return glm::mix(previous_camera_position, camera_position, alpha);
+    }
+
+    glm::vec3 shipPosition(float alpha) const {
+        return glm::mix(previous_ship_position, main_ship.world_pos, alpha);
+    }
+
+    glm::mat4 shipTransform(float alpha) const {
+        return glm::translate(glm::mat4(1.0f), shipPosition(alpha) - main_ship.world_pos) * main_ship.getWorldTransform();
+    }
+};
+
+#endif //SPACEOBJECTS_SIMULATION_H
@@ -0,0 +1,124 @@
+#include "StreamBuffer.h"
+#include "GLState.h"
+
+#include <cstring>
+#include <iostream>
+
+StreamBuffer::StreamBuffer(GLsizeiptr capacity) :
+    capacity(capacity),
+    // The bundled loader has no ARB_buffer_storage flag, core 4.4 implies it
+    persistent(GLAD_GL_VERSION_4_4 != 0) {
+
+    glGenBuffers(1, &buffer);
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    if (persistent) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, capacity, nullptr, flags);
+        mapped = static_cast<char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, capacity, flags));
+        if (mapped == nullptr) {
+            std::cerr << "Couldn't map stream buffer persistently" << std::endl;
+            persistent = false;
+
+            // The name may be handed out again, the cache must not believe it is still bound
+            gl_state().bindBuffer(GL_ARRAY_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            gl_state().bindBuffer(GL_ARRAY_BUFFER, buffer);
+        }
+    }
+
+    if (!persistent) {
+        glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+    }
+
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool StreamBuffer::overlaps(const FrameFence& fence, GLsizeiptr begin, GLsizeiptr end) const {
+    const auto intersect = [begin, end](GLsizeiptr other_begin, GLsizeiptr other_end) {
+        return begin < other_end && other_begin < end;
+    };
+
+    if (fence.begin <= fence.end) {
+        return intersect(fence.begin, fence.end);
+    }
+    return intersect(fence.begin, capacity) || intersect(0, fence.end);
+}
+
+void StreamBuffer::waitForRange(GLsizeiptr begin, GLsizeiptr end) {
+    // Frames complete in order, so waiting on the newest overlapping fence covers the older ones
+    size_t count = 0;
+    for (size_t i = 0; i < fences.size(); i++) {
+        if (overlaps(fences[i], begin, end)) {
+            count = i + 1;
+        }
+    }
+    if (count == 0) return;
+
+    const auto sync = fences[count - 1].sync;
+    GLenum status = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (status == GL_TIMEOUT_EXPIRED) {
+        status = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    }
+    if (status == GL_WAIT_FAILED) {
+        std::cerr << "Waiting for stream buffer fence failed" << std::endl;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        glDeleteSync(fences.front().sync);
+        fences.pop_front();
+    }
+}
+
+GLint StreamBuffer::write(const void* data, GLsizei count, GLsizei stride) {
+    const auto size = GLsizeiptr(count) * stride;
+    if (size == 0) return 0;
+    if (size > capacity) {
+        std::cerr << "Stream buffer is too small for " << size << " bytes" << std::endl;
+        return -1;
+    }
+
+    // Vertex-aligned, so the offset can be expressed as a first vertex
+    auto offset = (head + stride - 1) / stride * stride;
+    const bool wrap = offset + size > capacity;
+    if (wrap) {
+        offset = 0;
+    }
+
+    if (persistent) {
+        waitForRange(offset, offset + size);
+        std::memcpy(mapped + offset, data, size_t(size));
+    } else {
+        gl_state().bindBuffer(GL_ARRAY_BUFFER, buffer);
+        if (wrap) {
+            // The driver hands out fresh storage while the GPU keeps reading the old one
+            glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+        }
+
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        const auto dst = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, flags);
+        if (dst != nullptr) {
+            std::memcpy(dst, data, size_t(size));
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        gl_state().bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    head = offset + size;
+    frame_bytes += size_t(size);
+
+    return GLint(offset / stride);
+}
+
+void StreamBuffer::endFrame() {
+    if (persistent && head != frame_begin) {
+        fences.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), frame_begin, head});
+    }
+    frame_begin = head;
+
+    last_frame_bytes = frame_bytes;
+    total_bytes += frame_bytes;
+    frame_bytes = 0;
+    frames++;
+}
@@ -0,0 +1,65 @@
+#ifndef SPACEOBJECTS_STREAMBUFFER_H
+#define SPACEOBJECTS_STREAMBUFFER_H
+
+#include <cstddef>
+#include <deque>
+#include <glad/glad.h>
+
+// Ring buffer for vertex data that is rebuilt every frame (laser, text, debug lines).
+// Writes never stall on the GPU through implicit synchronization: with GL 4.4 the store
+// is mapped persistently and the ring waits on per-frame fences before reusing a region,
+// otherwise each write maps an unsynchronized range and the store is orphaned on wrap-around
+class StreamBuffer {
+    struct FrameFence {
+        GLsync sync;
+        GLsizeiptr begin;
+        GLsizeiptr end; // less than begin if the frame wrapped around
+    };
+
+    GLuint buffer;
+    GLsizeiptr capacity;
+    GLsizeiptr head = 0;
+
+    bool persistent;
+    char* mapped = nullptr;
+
+    std::deque<FrameFence> fences;
+    GLsizeiptr frame_begin = 0;
+
+    size_t frame_bytes = 0;
+    size_t last_frame_bytes = 0;
+    size_t total_bytes = 0;
+    size_t frames = 0;
+
+    bool overlaps(const FrameFence& fence, GLsizeiptr begin, GLsizeiptr end) const;
+
+    void waitForRange(GLsizeiptr begin, GLsizeiptr end);
+
+public:
+    explicit StreamBuffer(GLsizeiptr capacity = 4 << 20);
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // Attach this to vertex arrays once, the name never changes
+    GLuint getBuffer() const {
+        return buffer;
+    }
+
+    // Copies count vertices of stride bytes and returns the index of the first one,
+    // to be passed to glDraw* as the first vertex. Returns -1 if the data does not fit at all
+    GLint write(const void* data, GLsizei count, GLsizei stride);
+
+    // Fences everything written since the previous call, call once per frame after drawing
+    void endFrame();
+
+    size_t bytesLastFrame() const {
+        return last_frame_bytes;
+    }
+
+    double averageBytesPerFrame() const {
+        return frames != 0 ? double(total_bytes) / frames : 0.0;
+    }
+};
+
+#endif //SPACEOBJECTS_STREAMBUFFER_H
@@ -0,0 +1,239 @@
+#include "Texture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+std::vector<unsigned char> downsample(const std::vector<unsigned char>& pixels, int width, int height, int channels) {
+    const auto half_width = std::max(width / 2, 1);
+    const auto half_height = std::max(height / 2, 1);
+
+    std::vector<unsigned char> result(size_t(half_width) * half_height * channels);
+    for (int y = 0; y < half_height; y++) {
+        const int rows[2] = {2 * y, std::min(2 * y + 1, height - 1)};
+        for (int x = 0; x < half_width; x++) {
+            const int columns[2] = {2 * x, std::min(2 * x + 1, width - 1)};
+            for (int c = 0; c < channels; c++) {
+                int sum = 2;
+                for (const auto row : rows) {
+                    for (const auto column : columns) {
+                        sum += pixels[(size_t(row) * width + column) * channels + c];
+                    }
+                }
+                result[(size_t(y) * half_width + x) * channels + c] = static_cast<unsigned char>(sum / 4);
+            }
+        }
+    }
+    return result;
+}
+
+uint16_t pack_565(const float color[3]) {
+    const auto quantize = [](float value, int max) {
+        return std::min(std::max(int(value * max / 255.0f + 0.5f), 0), max);
+    };
+    return uint16_t(quantize(color[0], 31) << 11 | quantize(color[1], 63) << 5 | quantize(color[2], 31));
+}
+
+void unpack_565(uint16_t packed, float color[3]) {
+    const auto r = (packed >> 11) & 31;
+    const auto g = (packed >> 5) & 63;
+    const auto b = packed & 31;
+    color[0] = float(r << 3 | r >> 2);
+    color[1] = float(g << 2 | g >> 4);
+    color[2] = float(b << 3 | b >> 2);
+}
+
+void put_bytes(uint64_t value, int count, unsigned char* out) {
+    for (int i = 0; i < count; i++) {
+        out[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+// 4x4 texels as two 565 endpoints and a 2-bit index into the four colors between them.
+// The endpoints are the extremes of the block along the principal axis of its colors
+void encode_color_block(const float colors[16][3], unsigned char* out) {
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) mean[c] += colors[i][c] / 16.0f;
+    }
+
+    float covariance[3][3] = {};
+    for (int i = 0; i < 16; i++) {
+        const float d[3] = {colors[i][0] - mean[0], colors[i][1] - mean[1], colors[i][2] - mean[2]};
+        for (int a = 0; a < 3; a++) {
+            for (int b = 0; b < 3; b++) covariance[a][b] += d[a] * d[b];
+        }
+    }
+
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[3];
+        for (int a = 0; a < 3; a++) {
+            next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+        }
+        const auto norm = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (norm < 1e-6f) break; // flat block, any axis will do
+        for (int a = 0; a < 3; a++) axis[a] = next[a] / norm;
+    }
+
+    float t_min = 0.0f, t_max = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float t = 0.0f;
+        for (int c = 0; c < 3; c++) t += (colors[i][c] - mean[c]) * axis[c];
+        t_min = std::min(t_min, t);
+        t_max = std::max(t_max, t);
+    }
+
+    float high[3], low[3];
+    for (int c = 0; c < 3; c++) {
+        high[c] = mean[c] + t_max * axis[c];
+        low[c] = mean[c] + t_min * axis[c];
+    }
+
+    // color0 > color1 selects four-color mode in BC1
+    auto color0 = pack_565(high);
+    auto color1 = pack_565(low);
+    if (color0 < color1) std::swap(color0, color1);
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        float palette[4][3];
+        unpack_565(color0, palette[0]);
+        unpack_565(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            uint32_t best = 0;
+            float best_distance = 1e30f;
+            for (uint32_t p = 0; p < 4; p++) {
+                float distance = 0.0f;
+                for (int c = 0; c < 3; c++) {
+                    const auto d = colors[i][c] - palette[p][c];
+                    distance += d * d;
+                }
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best = p;
+                }
+            }
+            indices |= best << (2 * i);
+        }
+    }
+
+    put_bytes(color0, 2, out);
+    put_bytes(color1, 2, out + 2);
+    put_bytes(indices, 4, out + 4);
+}
+
+// The BC3 alpha half: 8-bit endpoints and a 3-bit index into the eight values between them
+void encode_alpha_block(const unsigned char alpha[16], unsigned char* out) {
+    const auto alpha0 = *std::max_element(alpha, alpha + 16);
+    const auto alpha1 = *std::min_element(alpha, alpha + 16);
+
+    uint64_t indices = 0;
+    if (alpha0 > alpha1) {
+        int palette[8] = {alpha0, alpha1};
+        for (int p = 2; p < 8; p++) {
+            palette[p] = ((8 - p) * alpha0 + (p - 1) * alpha1) / 7;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            uint64_t best = 0;
+            for (uint64_t p = 1; p < 8; p++) {
+                if (std::abs(alpha[i] - palette[p]) < std::abs(alpha[i] - palette[best])) best = p;
+            }
+            indices |= best << (3 * i);
+        }
+    }
+
+    out[0] = alpha0;
+    out[1] = alpha1;
+    put_bytes(indices, 6, out + 2);
+}
+
+void compress_level(const std::vector<unsigned char>& pixels, int width, int height, int channels, std::vector<unsigned char>& out) {
+    const auto block_size = channels == 4 ? 16 : 8;
+    const auto blocks_x = (width + 3) / 4;
+    const auto blocks_y = (height + 3) / 4;
+
+    auto block = out.size();
+    out.resize(block + size_t(blocks_x) * blocks_y * block_size);
+
+    for (int by = 0; by < blocks_y; by++) {
+        for (int bx = 0; bx < blocks_x; bx++) {
+            // Blocks hanging over the edge of small levels repeat the last row and column
+            float colors[16][3];
+            unsigned char alpha[16];
+            for (int i = 0; i < 16; i++) {
+                const auto x = std::min(4 * bx + i % 4, width - 1);
+                const auto y = std::min(4 * by + i / 4, height - 1);
+                const auto texel = pixels.data() + (size_t(y) * width + x) * channels;
+                for (int c = 0; c < 3; c++) colors[i][c] = texel[c];
+                alpha[i] = channels == 4 ? texel[3] : 255;
+            }
+
+            if (channels == 4) {
+                encode_alpha_block(alpha, &out[block]);
+                encode_color_block(colors, &out[block + 8]);
+            } else {
+                encode_color_block(colors, &out[block]);
+            }
+            block += block_size;
+        }
+    }
+}
+
+} // namespace
+
+TextureData build_texture(const ImageData& image, bool compress) {
+    TextureData texture;
+    if (image.pixels.empty()) return texture;
+
+    const auto channels = image.format == GL_RGBA ? 4 : 3;
+    texture.format = image.format;
+    texture.compressed = compress;
+    if (compress) {
+        texture.internal_format = channels == 4 ? COMPRESSED_RGBA_BC3 : COMPRESSED_RGB_BC1;
+    } else {
+        texture.internal_format = channels == 4 ? GL_RGBA8 : GL_RGB8;
+    }
+
+    auto pixels = image.pixels;
+    auto width = image.width;
+    auto height = image.height;
+    while (true) {
+        const auto offset = texture.data.size();
+        if (compress) {
+            compress_level(pixels, width, height, channels, texture.data);
+        } else {
+            texture.data.insert(texture.data.end(), pixels.begin(), pixels.end());
+        }
+        texture.levels.push_back({width, height, uint32_t(offset), uint32_t(texture.data.size() - offset)});
+
+        if (width == 1 && height == 1) break;
+
+        pixels = downsample(pixels, width, height, channels);
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+
+    return texture;
+}
+
+bool s3tc_supported() {
+    GLint num_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+
+    for (GLint i = 0; i < num_extensions; i++) {
+        const auto name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+        if (name != nullptr && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
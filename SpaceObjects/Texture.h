@@ -0,0 +1,42 @@
+#ifndef SPACEOBJECTS_TEXTURE_H
+#define SPACEOBJECTS_TEXTURE_H
+
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+
+#include "MeshData.h"
+
+// S3TC formats from EXT_texture_compression_s3tc, which the core 3.3 header does not define
+constexpr GLenum COMPRESSED_RGB_BC1 = 0x83F0;  // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+constexpr GLenum COMPRESSED_RGBA_BC3 = 0x83F3; // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+
+// One mip level, as a range of TextureData::data
+struct TextureLevel {
+    GLsizei width;
+    GLsizei height;
+    uint32_t offset;
+    uint32_t size;
+};
+
+// A texture ready for upload: the full mip chain, block-compressed or as plain bytes
+struct TextureData {
+    GLenum internal_format = 0;
+    GLenum format = GL_RGB; // pixel format of uncompressed levels
+    bool compressed = false;
+    std::vector<TextureLevel> levels; // finest first, down to 1x1
+    std::vector<unsigned char> data;
+
+    bool empty() const {
+        return levels.empty();
+    }
+};
+
+// Box-filtered mip chain of a decoded RGB or RGBA image. Compressed textures use BC1 for RGB
+// and BC3 for RGBA, 4 and 8 bits per pixel against 24 and 32
+TextureData build_texture(const ImageData& image, bool compress);
+
+// Whether the driver can sample S3TC textures, needs a GL context
+bool s3tc_supported();
+
+#endif //SPACEOBJECTS_TEXTURE_H
@@ -0,0 +1,187 @@
+#include "TextureArray.h"
+#include "GLState.h"
+#include "common.h"
+
+#include <algorithm>
+
+constexpr int TextureArrays::layers_per_array;
+
+TextureArrays& texture_arrays() {
+    static TextureArrays instance;
+    return instance;
+}
+
+size_t TextureArrays::Array::layerSize() const {
+    size_t size = 0;
+    for (const auto& level : levels) {
+        size += level.size;
+    }
+    return size;
+}
+
+bool TextureArrays::matches(const Array& array, const TextureData& texture) {
+    const auto& base = texture.levels.front();
+    return array.internal_format == texture.internal_format
+        && array.levels.front().width == base.width
+        && array.levels.front().height == base.height
+        && array.levels.size() == texture.levels.size();
+}
+
+void TextureArrays::specify(const Array& array, int num_layers) {
+    for (size_t i = 0; i < array.levels.size(); i++) {
+        const auto& level = array.levels[i];
+        if (array.compressed) {
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, GLint(i), array.internal_format, level.width, level.height, num_layers, 0,
+                                   GLsizei(level.size) * num_layers, nullptr);
+        } else {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, GLint(i), array.internal_format, level.width, level.height, num_layers, 0,
+                         array.format, GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+}
+
+TextureArrays::Array TextureArrays::create(const TextureData& texture) {
+    Array array;
+    array.internal_format = texture.internal_format;
+    array.format = texture.format;
+    array.compressed = texture.compressed;
+    array.levels = texture.levels;
+    array.used.assign(1, false);
+    array.num_used = 0;
+
+    glGenTextures(1, &array.name);
+    gl_state().bindTexture(GL_TEXTURE_2D_ARRAY, array.name);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, GLint(array.levels.size()) - 1);
+
+    specify(array, 1);
+    GL_CHECK_ERRORS;
+
+    return array;
+}
+
+void TextureArrays::grow(Array& array) {
+    const auto num_layers = GLsizei(array.used.size());
+    const auto layer_size = array.layerSize();
+
+    // The layers are copied out into a buffer object and back after respecifying the storage,
+    // which keeps them in video memory where the driver can manage it
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(layer_size * num_layers), nullptr, GL_STREAM_COPY);
+
+    gl_state().bindTexture(GL_TEXTURE_2D_ARRAY, array.name);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    size_t offset = 0;
+    for (size_t i = 0; i < array.levels.size(); i++) {
+        const auto data = reinterpret_cast<void*>(offset);
+        if (array.compressed) {
+            glGetCompressedTexImage(GL_TEXTURE_2D_ARRAY, GLint(i), data);
+        } else {
+            glGetTexImage(GL_TEXTURE_2D_ARRAY, GLint(i), array.format, GL_UNSIGNED_BYTE, data);
+        }
+        offset += array.levels[i].size * num_layers;
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    specify(array, num_layers + 1);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    offset = 0;
+    for (size_t i = 0; i < array.levels.size(); i++) {
+        const auto& level = array.levels[i];
+        const auto data = reinterpret_cast<const void*>(offset);
+        if (array.compressed) {
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, GLint(i), 0, 0, 0, level.width, level.height, num_layers,
+                                      array.internal_format, GLsizei(level.size) * num_layers, data);
+        } else {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, GLint(i), 0, 0, 0, level.width, level.height, num_layers,
+                            array.format, GL_UNSIGNED_BYTE, data);
+        }
+        offset += level.size * num_layers;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &buffer);
+    GL_CHECK_ERRORS;
+
+    array.used.push_back(false);
+}
+
+TextureLayer TextureArrays::allocate(const TextureData& texture) {
+    TextureLayer result;
+    if (texture.empty()) return result;
+
+    // A free layer first, then a layer more in an array that has room for it, then a new array
+    auto array = std::find_if(arrays.begin(), arrays.end(), [&](const Array& array) {
+        return matches(array, texture) && array.num_used < int(array.used.size());
+    });
+    if (array == arrays.end()) {
+        array = std::find_if(arrays.begin(), arrays.end(), [&](const Array& array) {
+            return matches(array, texture) && array.used.size() < layers_per_array;
+        });
+        if (array != arrays.end()) {
+            grow(*array);
+        } else {
+            arrays.push_back(create(texture));
+            array = arrays.end() - 1;
+        }
+    }
+
+    const auto layer = std::find(array->used.begin(), array->used.end(), false) - array->used.begin();
+    array->used[layer] = true;
+    array->num_used++;
+
+    result.array = array->name;
+    result.layer = GLint(layer);
+
+    gl_state().bindTexture(GL_TEXTURE_2D_ARRAY, array->name);
+
+    // Rows of RGB levels are tightly packed
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t i = 0; i < texture.levels.size(); i++) {
+        const auto& level = texture.levels[i];
+        const auto pixels = texture.data.data() + level.offset;
+        if (texture.compressed) {
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, GLint(i), 0, 0, result.layer, level.width, level.height, 1,
+                                      texture.internal_format, GLsizei(level.size), pixels);
+        } else {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, GLint(i), 0, 0, result.layer, level.width, level.height, 1,
+                            texture.format, GL_UNSIGNED_BYTE, pixels);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    GL_CHECK_ERRORS;
+
+    return result;
+}
+
+void TextureArrays::release(const TextureLayer& layer) {
+    const auto array = std::find_if(arrays.begin(), arrays.end(), [&](const Array& array) {
+        return array.name == layer.array;
+    });
+    if (array == arrays.end() || !array->used[layer.layer]) return;
+
+    array->used[layer.layer] = false;
+    if (--array->num_used == 0) {
+        glDeleteTextures(1, &array->name);
+        // Deleting unbinds the name from every unit behind the state cache's back
+        gl_state().invalidate();
+        arrays.erase(array);
+    }
+}
+
+size_t TextureArrays::residentBytes() const {
+    size_t bytes = 0;
+    for (const auto& array : arrays) {
+        bytes += array.layerSize() * array.used.size();
+    }
+    return bytes;
+}
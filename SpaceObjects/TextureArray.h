@@ -0,0 +1,67 @@
+#ifndef SPACEOBJECTS_TEXTUREARRAY_H
+#define SPACEOBJECTS_TEXTUREARRAY_H
+
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+
+#include "Texture.h"
+
+// Where a texture lives: a layer of a GL_TEXTURE_2D_ARRAY
+struct TextureLayer {
+    GLuint array = 0;
+    GLint layer = 0;
+};
+
+// Stores textures as layers of array textures, grouped by size, format and number of levels.
+// Materials whose textures share an array are drawn without a texture bind between them,
+// only the layer uniform changes. An array holds only as many layers as it was ever asked for:
+// it starts with one and gains another, keeping its name, when a texture finds no free layer.
+// A group that reaches layers_per_array gets another array, and an array is deleted once all
+// of its layers are released
+class TextureArrays {
+public:
+    static constexpr int layers_per_array = 8;
+
+private:
+    struct Array {
+        GLuint name;
+        GLenum internal_format;
+        GLenum format;
+        bool compressed;
+        std::vector<TextureLevel> levels; // sizes of one layer, offsets unused
+        std::vector<bool> used;           // one per layer
+        int num_used;
+
+        size_t layerSize() const;
+    };
+
+    std::vector<Array> arrays;
+
+    static bool matches(const Array& array, const TextureData& texture);
+
+    // Respecifies every level of the bound array with num_layers layers and no data
+    static void specify(const Array& array, int num_layers);
+
+    Array create(const TextureData& texture);
+
+    void grow(Array& array);
+
+public:
+    // Uploads all levels of the texture into a free layer, needs a GL context
+    TextureLayer allocate(const TextureData& texture);
+
+    void release(const TextureLayer& layer);
+
+    size_t numArrays() const {
+        return arrays.size();
+    }
+
+    // Storage of all arrays as specified, free layers included. Drivers may pad uncompressed
+    // RGB texels to four bytes on top of this
+    size_t residentBytes() const;
+};
+
+TextureArrays& texture_arrays();
+
+#endif //SPACEOBJECTS_TEXTUREARRAY_H
@@ -0,0 +1,145 @@
+#include "TextureCache.h"
+#include "CacheFile.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+constexpr uint32_t CACHE_MAGIC = 0x43544f53; // "SOTC"
+constexpr uint32_t CACHE_VERSION = 1;
+
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t source_hash;
+    uint32_t internal_format;
+    uint32_t format;
+    uint32_t compressed;
+    uint32_t reserved;
+};
+
+bool parse(Reader& reader, const CacheHeader& header, TextureData& texture) {
+    texture.internal_format = header.internal_format;
+    texture.format = header.format;
+    texture.compressed = header.compressed != 0;
+
+    if (!reader.read_array(texture.levels) || !reader.read_array(texture.data)) return false;
+    if (texture.levels.empty()) return false;
+
+    for (const auto& level : texture.levels) {
+        if (level.width <= 0 || level.height <= 0 || uint64_t(level.offset) + level.size > texture.data.size()) {
+            return false;
+        }
+    }
+
+    return reader.cur == reader.end;
+}
+
+} // namespace
+
+std::string TextureCache::path(const std::string& source_path, bool compressed) {
+    return source_path + (compressed ? ".bc.texcache" : ".rgba.texcache");
+}
+
+bool TextureCache::load(const std::string& source_path, bool compressed, TextureData& texture) {
+    SourceStamp stamp;
+    if (!stat_source(source_path, stamp)) return false;
+
+    const auto cache_path = path(source_path, compressed);
+    CacheHeader header;
+    {
+        MappedFile file(cache_path);
+        if (file.data() == nullptr) return false;
+
+        Reader reader {file.data(), file.data() + file.size()};
+        if (!reader.read(header)
+            || header.magic != CACHE_MAGIC
+            || header.version != CACHE_VERSION
+            || header.source_size != stamp.size
+            || (header.compressed != 0) != compressed) {
+            return false;
+        }
+
+        if (header.source_mtime != stamp.mtime && header.source_hash != hash_source(source_path)) {
+            return false;
+        }
+
+        if (!parse(reader, header, texture)) {
+            std::cerr << "Corrupted texture cache: " << cache_path << std::endl;
+            texture = TextureData();
+            return false;
+        }
+    }
+
+    if (header.source_mtime != stamp.mtime) {
+        header.source_mtime = stamp.mtime;
+
+        std::fstream file(cache_path, std::ios::binary | std::ios::in | std::ios::out);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+    return true;
+}
+
+bool TextureCache::sourceHash(const std::string& source_path, const SourceStamp& stamp, uint64_t& hash) {
+    for (const auto compressed : {true, false}) {
+        std::ifstream file(path(source_path, compressed), std::ios::binary);
+
+        CacheHeader header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) continue;
+
+        if (header.magic == CACHE_MAGIC
+            && header.version == CACHE_VERSION
+            && header.source_size == stamp.size
+            && header.source_mtime == stamp.mtime) {
+            hash = header.source_hash;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TextureCache::store(const std::string& source_path, const TextureData& texture) {
+    SourceStamp stamp;
+    if (!stat_source(source_path, stamp)) return false;
+
+    CacheHeader header;
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.source_size = stamp.size;
+    header.source_mtime = stamp.mtime;
+    header.source_hash = hash_source(source_path);
+    header.internal_format = texture.internal_format;
+    header.format = texture.format;
+    header.compressed = texture.compressed ? 1 : 0;
+    header.reserved = 0;
+
+    const auto cache_path = path(source_path, texture.compressed);
+    const auto tmp_path = temporary_path(cache_path);
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "Couldn't write texture cache: " << cache_path << std::endl;
+            return false;
+        }
+
+        Writer writer {out};
+        writer.write(header);
+        writer.write_array(texture.levels);
+        writer.write_array(texture.data);
+
+        if (!out.good()) {
+            out.close();
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    std::remove(cache_path.c_str());
+    return std::rename(tmp_path.c_str(), cache_path.c_str()) == 0;
+}
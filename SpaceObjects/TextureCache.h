@@ -0,0 +1,27 @@
+#ifndef SPACEOBJECTS_TEXTURECACHE_H
+#define SPACEOBJECTS_TEXTURECACHE_H
+
+#include <cstdint>
+#include <string>
+
+#include "CacheFile.h"
+#include "Texture.h"
+
+// Built mip chains stored next to the source image, so later runs upload them without
+// decoding the image. Validated against the source like MeshCache entries. Compressed and
+// uncompressed chains are kept in separate files, so switching the setting back reuses the old one
+class TextureCache {
+public:
+    // <source>.bc.texcache or <source>.rgba.texcache
+    static std::string path(const std::string& source_path, bool compressed);
+
+    static bool load(const std::string& source_path, bool compressed, TextureData& texture);
+
+    static bool store(const std::string& source_path, const TextureData& texture);
+
+    // Content hash recorded by a cache of either variant written while the source had this
+    // size and modification time, so a cached source is identified without reading it
+    static bool sourceHash(const std::string& source_path, const SourceStamp& stamp, uint64_t& hash);
+};
+
+#endif //SPACEOBJECTS_TEXTURECACHE_H
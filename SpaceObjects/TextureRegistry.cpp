@@ -0,0 +1,130 @@
+#include "TextureRegistry.h"
+#include "TextureCache.h"
+
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <unordered_set>
+
+namespace {
+
+std::string canonical_path(const std::string& path) {
+#ifdef _WIN32
+    char resolved[_MAX_PATH];
+    if (_fullpath(resolved, path.c_str(), _MAX_PATH) != nullptr) return resolved;
+#else
+    char resolved[PATH_MAX];
+    if (realpath(path.c_str(), resolved) != nullptr) return resolved;
+#endif
+    return path;
+}
+
+} // namespace
+
+GLTexture::~GLTexture() {
+    if (!texture_registry().contextAlive()) return;
+
+    texture_arrays().release(slot);
+}
+
+TextureRegistry& texture_registry() {
+    static TextureRegistry registry;
+    return registry;
+}
+
+TextureKey TextureRegistry::key(const std::string& path) {
+    TextureKey key;
+    SourceStamp stamp;
+    if (path.empty()) return key;
+    if (!stat_source(path, stamp)) {
+        std::cerr << "Missing texture: " << path << std::endl;
+        return key;
+    }
+
+    key.path = canonical_path(path);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto known = hashes.find(key.path);
+        if (known != hashes.end() && known->second.stamp.size == stamp.size && known->second.stamp.mtime == stamp.mtime) {
+            key.hash = known->second.hash;
+            return key;
+        }
+    }
+
+    // Hashing happens outside the lock, loader threads may be keying other files meanwhile
+    if (!TextureCache::sourceHash(path, stamp, key.hash)) {
+        key.hash = hash_source(path);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    hashes[key.path] = {stamp, key.hash};
+    return key;
+}
+
+TextureHandle TextureRegistry::find(const TextureKey& key) const {
+    const auto path = by_path.find(key.path);
+    if (path != by_path.end()) {
+        if (auto texture = path->second.lock()) return texture;
+    }
+
+    const auto hash = by_hash.find(key.hash);
+    if (hash != by_hash.end()) {
+        return hash->second.lock();
+    }
+    return nullptr;
+}
+
+bool TextureRegistry::resident(const TextureKey& key) {
+    if (key.path.empty()) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return find(key) != nullptr;
+}
+
+TextureHandle TextureRegistry::acquire(const TextureKey& key, const TextureData& texture) {
+    if (key.path.empty()) return nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    requested++;
+
+    auto handle = find(key);
+    if (handle == nullptr) {
+        if (texture.empty()) {
+            std::cerr << "No texture data for " << key.path << std::endl;
+            return nullptr;
+        }
+        handle = std::make_shared<const GLTexture>(texture_arrays().allocate(texture), texture.data.size());
+        by_hash[key.hash] = handle;
+    }
+
+    by_path[key.path] = handle;
+    return handle;
+}
+
+TextureRegistryStats TextureRegistry::stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    TextureRegistryStats stats;
+    stats.requested = requested;
+
+    std::unordered_set<const GLTexture*> alive;
+    for (auto entry = by_path.begin(); entry != by_path.end();) {
+        const auto texture = entry->second.lock();
+        if (texture == nullptr) {
+            entry = by_path.erase(entry);
+            continue;
+        }
+        if (alive.insert(texture.get()).second) {
+            stats.bytes += texture->size();
+        }
+        ++entry;
+    }
+    stats.unique = int(alive.size());
+
+    for (auto entry = by_hash.begin(); entry != by_hash.end();) {
+        entry = entry->second.expired() ? by_hash.erase(entry) : std::next(entry);
+    }
+
+    return stats;
+}
@@ -0,0 +1,102 @@
+#ifndef SPACEOBJECTS_TEXTUREREGISTRY_H
+#define SPACEOBJECTS_TEXTUREREGISTRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <glad/glad.h>
+
+#include "CacheFile.h"
+#include "Texture.h"
+#include "TextureArray.h"
+
+// A texture shared through TextureHandle, its array layer is released when the last handle goes
+class GLTexture {
+    TextureLayer slot;
+    size_t bytes;
+
+public:
+    GLTexture(const TextureLayer& slot, size_t bytes) :
+        slot(slot),
+        bytes(bytes) {}
+
+    ~GLTexture();
+
+    GLTexture(const GLTexture&) = delete;
+    GLTexture& operator=(const GLTexture&) = delete;
+
+    // The GL_TEXTURE_2D_ARRAY holding the texture
+    GLuint get() const {
+        return slot.array;
+    }
+
+    GLint layer() const {
+        return slot.layer;
+    }
+
+    size_t size() const {
+        return bytes;
+    }
+};
+
+using TextureHandle = std::shared_ptr<const GLTexture>;
+
+// Identity of an image file: the same canonical path or the same content is the same texture
+struct TextureKey {
+    std::string path; // empty for no texture
+    uint64_t hash = 0;
+};
+
+struct TextureRegistryStats {
+    int requested = 0;  // handles handed out
+    int unique = 0;     // textures alive
+    size_t bytes = 0;   // uploaded size of the textures alive
+};
+
+// Process-wide map from image files to the textures uploaded from them. Holds no references
+// itself, so a texture lives exactly as long as the materials using it
+class TextureRegistry {
+    // Content hash of a file as of a size and modification time
+    struct SourceHash {
+        SourceStamp stamp;
+        uint64_t hash;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, std::weak_ptr<const GLTexture>> by_path;
+    std::unordered_map<uint64_t, std::weak_ptr<const GLTexture>> by_hash;
+    std::unordered_map<std::string, SourceHash> hashes; // by canonical path
+    int requested = 0;
+    std::atomic<bool> context_alive {true}; // read by GLTexture destructors, possibly under the mutex
+
+    TextureHandle find(const TextureKey& key) const;
+
+public:
+    // Does not need a GL context. The file is only read through when neither this registry
+    // nor its texture cache knows the hash of its current version
+    TextureKey key(const std::string& path);
+
+    // Whether acquire() would share an existing texture, so the image need not be decoded
+    bool resident(const TextureKey& key);
+
+    // The live texture of the key, or a new one uploaded from texture. Null for an empty key
+    TextureHandle acquire(const TextureKey& key, const TextureData& texture);
+
+    TextureRegistryStats stats();
+
+    // Called before the context is destroyed: textures released afterwards are not freed
+    void detachContext() {
+        context_alive = false;
+    }
+
+    bool contextAlive() const {
+        return context_alive;
+    }
+};
+
+TextureRegistry& texture_registry();
+
+#endif //SPACEOBJECTS_TEXTUREREGISTRY_H
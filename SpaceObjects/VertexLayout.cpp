@@ -0,0 +1,113 @@
+#include "VertexLayout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+GLsizei type_size(GLenum type) {
+    switch (type) {
+        case GL_FLOAT:
+            return 4;
+        case GL_HALF_FLOAT:
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+template <typename T>
+void store(unsigned char* out, T value) {
+    std::memcpy(out, &value, sizeof(T));
+}
+
+void convert(float value, GLenum type, unsigned char* out) {
+    switch (type) {
+        case GL_FLOAT:
+            store(out, value);
+            break;
+        case GL_HALF_FLOAT:
+            store(out, to_half(value));
+            break;
+        case GL_UNSIGNED_SHORT:
+            store(out, uint16_t(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f)));
+            break;
+        case GL_SHORT:
+            store(out, int16_t(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f)));
+            break;
+        case GL_UNSIGNED_BYTE:
+            store(out, uint8_t(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f)));
+            break;
+        default:
+            store(out, int8_t(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 127.0f)));
+            break;
+    }
+}
+
+} // namespace
+
+uint16_t to_half(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    const auto sign = uint16_t(bits >> 16 & 0x8000u);
+    const auto exponent = int(bits >> 23 & 0xff) - 127 + 15;
+    auto mantissa = bits & 0x7fffffu;
+
+    if (exponent >= 31) {
+        // Too large, infinity or NaN
+        const bool nan = (bits & 0x7fffffffu) > 0x7f800000u;
+        return uint16_t(sign | 0x7c00u | (nan ? 0x200u : 0u));
+    }
+    if (exponent <= 0) {
+        // Subnormal or zero
+        if (exponent < -10) return sign;
+        mantissa |= 0x800000u;
+        const auto shift = 14 - exponent;
+        auto half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1u) half++;
+        return uint16_t(sign | half);
+    }
+
+    auto half = uint32_t(sign) | uint32_t(exponent) << 10 | mantissa >> 13;
+    // A carry out of the mantissa rounds up into the exponent, which is still correct
+    if (mantissa & 0x1000u) half++;
+    return uint16_t(half);
+}
+
+VertexLayout& VertexLayout::add(GLuint location, GLint components, GLenum type) {
+    attributes.push_back({location, components, type, stride});
+    stride += (components * type_size(type) + 3) / 4 * 4;
+    return *this;
+}
+
+std::vector<unsigned char> VertexLayout::interleave(const std::vector<const float*>& sources, size_t num_vertices) const {
+    std::vector<unsigned char> result(num_vertices * stride, 0);
+
+    for (size_t a = 0; a < attributes.size(); a++) {
+        const auto& attribute = attributes[a];
+        const auto size = type_size(attribute.type);
+        for (size_t v = 0; v < num_vertices; v++) {
+            const auto in = sources[a] + v * attribute.components;
+            auto out = result.data() + v * stride + attribute.offset;
+            for (GLint c = 0; c < attribute.components; c++) {
+                convert(in[c], attribute.type, out + c * size);
+            }
+        }
+    }
+
+    return result;
+}
+
+void VertexLayout::apply() const {
+    for (const auto& attribute : attributes) {
+        const bool normalized = attribute.type != GL_FLOAT && attribute.type != GL_HALF_FLOAT;
+
+        glEnableVertexAttribArray(attribute.location);
+        glVertexAttribPointer(attribute.location, attribute.components, attribute.type, normalized ? GL_TRUE : GL_FALSE,
+                              stride, reinterpret_cast<const void*>(size_t(attribute.offset)));
+    }
+}
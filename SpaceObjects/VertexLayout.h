@@ -0,0 +1,40 @@
+#ifndef SPACEOBJECTS_VERTEXLAYOUT_H
+#define SPACEOBJECTS_VERTEXLAYOUT_H
+
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+
+// Attributes of one interleaved vertex buffer. Each attribute starts 4-byte aligned
+class VertexLayout {
+public:
+    struct Attribute {
+        GLuint location;
+        GLint components;
+        GLenum type; // GL_FLOAT, GL_HALF_FLOAT or a normalized GL_(UNSIGNED_)SHORT/BYTE
+        GLsizei offset;
+    };
+
+private:
+    std::vector<Attribute> attributes;
+    GLsizei stride = 0;
+
+public:
+    VertexLayout& add(GLuint location, GLint components, GLenum type);
+
+    GLsizei getStride() const {
+        return stride;
+    }
+
+    // Packs one float array per attribute, in the order they were added, into a single buffer.
+    // Normalized types take values in [0, 1] (unsigned) or [-1, 1] (signed)
+    std::vector<unsigned char> interleave(const std::vector<const float*>& sources, size_t num_vertices) const;
+
+    // Points the attributes of the bound vertex array at the bound GL_ARRAY_BUFFER
+    void apply() const;
+};
+
+// IEEE 754 binary16, rounded to nearest
+uint16_t to_half(float value);
+
+#endif //SPACEOBJECTS_VERTEXLAYOUT_H
@@ -1,17 +1,26 @@
 // Internal includes
 #include "common.h"
+#include "AllocCounter.h"
 #include "ShaderProgram.h"
+#include "InstancedRenderer.h"
 #include "ModelFactories.h"
 #include "Camera.h"
 #include "Font.h"
+#include "GLState.h"
+#include "CpuParticles.h"
+#include "Headless.h"
+#include "Impostor.h"
+#include "RenderQueue.h"
+#include "ParticleSystem.h"
+#include "Simulation.h"
 
 // External dependencies
 #define GLFW_DLL
 #include <GLFW/glfw3.h>
+#include <memory>
 #include <random>
 #include <il.h>
 #include <glm/gtx/vector_angle.hpp>
-#include <list>
 
 // Window size
 static const GLsizei WIDTH = 1280, HEIGHT = 720;
@@ -42,6 +51,7 @@ static bool permitMouseMove = false;
 
 // Prepare transformations
 const auto perspective = glm::perspective(glm::radians(45.0f), float(WIDTH) / HEIGHT, 0.1f, 1000.0f);
+const auto focal_length = HEIGHT / (2.0f * std::tan(glm::radians(45.0f) / 2.0f));
 
 static float yaw = 0.0;
 static float pitch = 0.0;
@@ -61,6 +71,8 @@ static void mouseMove(GLFWwindow *window, double xpos, double ypos) {
     my = y1;
 }
 
+static bool show_render_stats = false;
+
 static bool shoot = false;
 // Callback for actions with mouse buttons
 // Permit camera movements with left button pressed only
@@ -144,6 +156,11 @@ static void keyboardControls(GLFWwindow *window, int key, int scancode, int acti
                 multiplier /= 2;
             }
             break;
+        case GLFW_KEY_F1:
+            if (action == GLFW_PRESS) {
+                show_render_stats = !show_render_stats;
+            }
+            break;
         case GLFW_KEY_F2:
             if (action == GLFW_PRESS) {
                 camera_mode = CameraMode::FIRST_PERSON;
@@ -170,9 +187,113 @@ enum class ShaderType {
     EXPLOSION,
     TEXT,
     LASER,
+    PARTICLE_UPDATE,
+    PARTICLE_RENDER,
+    IMPOSTOR,
+};
+
+// Per-frame values read by the uniform setters of the render queue
+struct FrameState {
+    glm::mat4 view_projection;
+    glm::vec3 eye;
+    glm::mat4 sky_transform;
+    glm::mat4 starfield_world;
+    glm::mat4 starfield_projection;
+    glm::vec3 starfield_velocity;
+    glm::vec2 crosshair_position;
+    glm::mat4 hud_transform;
+};
+
+static const FrameState& frame_state(const void* data) {
+    return *static_cast<const FrameState*>(data);
+}
+
+static void set_mesh_uniforms(const ShaderProgram& program, const void* data) {
+    program.SetUniform("view_projection", frame_state(data).view_projection);
+}
+
+static void set_impostor_uniforms(const ShaderProgram& program, const void* data) {
+    program.SetUniform("view_projection", frame_state(data).view_projection);
+    program.SetUniform("eye", frame_state(data).eye);
+}
+
+static void set_sky_uniforms(const ShaderProgram& program, const void* data) {
+    program.SetUniform("transform", frame_state(data).sky_transform);
+}
+
+static void set_starfield_uniforms(const ShaderProgram& program, const void* data) {
+    const auto& frame = frame_state(data);
+    program.SetUniform("world_transform", frame.starfield_world);
+    program.SetUniform("perspective_transform", frame.starfield_projection);
+    program.SetUniform("velocity", frame.starfield_velocity);
+}
+
+static void set_particle_uniforms(const ShaderProgram& program, const void* data) {
+    program.SetUniform("view_projection", frame_state(data).view_projection);
+    program.SetUniform("point_scale", 0.15f * HEIGHT);
+}
+
+static void set_laser_uniforms(const ShaderProgram& program, const void* data) {
+    program.SetUniform("transform", frame_state(data).view_projection);
+}
+
+static void set_crosshair_uniforms(const ShaderProgram& program, const void* data) {
+    program.SetUniform("position", frame_state(data).crosshair_position);
+}
+
+static void set_text_uniforms(const ShaderProgram& program, const void* data) {
+    program.SetUniform("transform", frame_state(data).hud_transform);
+}
+
+// Laser beam of the frame, line width fades with the recharge
+struct LaserDraw {
+    Laser& laser;
+    glm::vec3 src, dst;
+    float width;
+
+    void draw() {
+        gl_state().lineWidth(width);
+        laser.draw(src, dst);
+        gl_state().lineWidth(1.0f);
+    }
 };
 
 int main(int argc, char **argv) {
+    // main --headless N [seed]: simulate N ticks without a window and report timings
+    if (argc >= 3 && std::string(argv[1]) == "--headless") {
+        return run_headless(std::strtoull(argv[2], nullptr, 10), argc >= 4 ? unsigned(std::strtoul(argv[3], nullptr, 10)) : 0u);
+    }
+    // main --particle-benchmark N [frames]: time the CPU particle update on N particles
+    if (argc >= 3 && std::string(argv[1]) == "--particle-benchmark") {
+        return run_particle_benchmark(std::strtoull(argv[2], nullptr, 10), argc >= 4 ? unsigned(std::strtoul(argv[3], nullptr, 10)) : 600u);
+    }
+    // main --entity-benchmark [steps]: time EntityStore::integrate against a list of Asteroid objects
+    if (argc >= 2 && std::string(argv[1]) == "--entity-benchmark") {
+        return run_entity_benchmark(argc >= 3 ? unsigned(std::strtoul(argv[2], nullptr, 10)) : 1000u);
+    }
+    // main --collision-benchmark N [frames]: time the collision grid on N moving boxes
+    if (argc >= 3 && std::string(argv[1]) == "--collision-benchmark") {
+        return run_collision_benchmark(std::strtoull(argv[2], nullptr, 10), argc >= 4 ? unsigned(std::strtoul(argv[3], nullptr, 10)) : 600u);
+    }
+    // main --picking-benchmark N [rays]: time ray picking among N targets
+    if (argc >= 3 && std::string(argv[1]) == "--picking-benchmark") {
+        return run_picking_benchmark(std::strtoull(argv[2], nullptr, 10), argc >= 4 ? unsigned(std::strtoul(argv[3], nullptr, 10)) : 10000u);
+    }
+    // main --check-loader: import the models on one thread and on all of them, without the mesh cache, and compare
+    if (argc >= 2 && std::string(argv[1]) == "--check-loader") {
+        return run_loader_check();
+    }
+    // main --vertex-report: GPU buffer bytes of every model, float buffers against the packed layout
+    if (argc >= 2 && std::string(argv[1]) == "--vertex-report") {
+        return run_vertex_report();
+    }
+    // main --check-particles: compare the GPU particle update with the CPU reference, e.g. under a software GL
+    // main --cpu-particles: simulate particles on the CPU instead, for drivers with slow transform feedback
+    const bool check_particles = argc >= 2 && std::string(argv[1]) == "--check-particles";
+    const bool cpu_particles = argc >= 2 && std::string(argv[1]) == "--cpu-particles";
+    // main --impostor-distance D: asteroids further than D are drawn as impostors, 0 never does
+    const float impostor_distance = argc >= 3 && std::string(argv[1]) == "--impostor-distance" ? std::strtof(argv[2], nullptr) : 150.0f;
+
     if (!glfwInit())
         return -1;
 
@@ -245,15 +366,34 @@ int main(int argc, char **argv) {
         {GL_VERTEX_SHADER,   "shaders/laser_vertex.glsl"},
         {GL_FRAGMENT_SHADER, "shaders/laser_fragment.glsl"},
     });
+    shader_programs[ShaderType::PARTICLE_UPDATE] = ShaderProgram({
+        {GL_VERTEX_SHADER,   "shaders/particle_update_vertex.glsl"},
+    });
+    shader_programs[ShaderType::PARTICLE_RENDER] = ShaderProgram({
+        {GL_VERTEX_SHADER,   "shaders/particle_render_vertex.glsl"},
+        {GL_FRAGMENT_SHADER, "shaders/particle_render_fragment.glsl"},
+    });
+    shader_programs[ShaderType::IMPOSTOR] = ShaderProgram({
+        {GL_VERTEX_SHADER,   "shaders/impostor_vertex.glsl"},
+        {GL_FRAGMENT_SHADER, "shaders/impostor_fragment.glsl"},
+    });
     GL_CHECK_ERRORS;
 
+    const MeshUniforms classic_uniforms(shader_programs[ShaderType::CLASSIC]);
+    const MeshUniforms explosion_uniforms(shader_programs[ShaderType::EXPLOSION]);
+    InstancedRenderer mesh_renderer;
+    InstancedRenderer explosion_renderer;
+    RenderQueue render_queue;
+    FrustumCuller entity_culler;
+    std::vector<glm::mat4> entity_transforms;
+
     std::cout << "\x1b[32mDone\x1b[0m" << std::endl;
 
     Camera camera;
 
     std::cout << "Loading skybox... ";
 
-    const auto skybox = SkyBox::create({
+    auto skybox = SkyBox::create({
         "models/necro_nebula/little_GalaxyTex_PositiveX.png",
         "models/necro_nebula/little_GalaxyTex_NegativeX.png",
         "models/necro_nebula/little_GalaxyTex_NegativeY.png",
@@ -266,41 +406,83 @@ int main(int argc, char **argv) {
 
     Particles particles(1000);
 
+    // Engine trails and explosions
+    const uint32_t max_particles = 1u << 18;
+    ParticleSystem* gpu_particles = nullptr;
+    std::unique_ptr<ParticleBackend> particle_system;
+    if (cpu_particles) {
+        particle_system.reset(new CpuParticleSystem(max_particles));
+    } else {
+        gpu_particles = new ParticleSystem(shader_programs[ShaderType::PARTICLE_UPDATE], max_particles);
+        gpu_particles->setReferenceCheck(check_particles);
+        particle_system.reset(gpu_particles);
+    }
+    float trail_particles = 0.0f; // fraction of a particle left over from the previous frame
+
     Crosshair crosshair;
 
-    Laser laser;
-    constexpr int laser_recharge_rate = 15;
+    // Per-frame geometry of the laser, text and debug drawing
+    StreamBuffer stream_buffer;
+
+    Laser laser(stream_buffer);
 
     std::cout << "Loading models... ";
 
-    ModelFactory model_factory;
+    const auto models_start = glfwGetTime();
 
+    const auto compress_textures = s3tc_supported();
+    if (!compress_textures) {
+        std::cerr << "S3TC is not supported, textures stay uncompressed" << std::endl;
+    }
+    ModelFactory model_factory(compress_textures ? AssetMode::RENDER : AssetMode::RENDER_UNCOMPRESSED);
+
+    const auto& load_stats = model_factory.load_stats();
+    std::cout << "\x1b[32mDone\x1b[0m"
+              << " (" << int(1000.0 * (glfwGetTime() - models_start)) << " ms:"
+              << " cached " << load_stats.cache_hits << "/" << load_stats.cache_hits + load_stats.cache_misses
+              << ", cache " << int(load_stats.cache_ms) << " ms"
+              << ", import " << int(load_stats.import_ms) << " ms"
+              << ", textures cached " << load_stats.texture_cache_hits << "/" << load_stats.texture_cache_hits + load_stats.texture_cache_misses
+              << " " << int(load_stats.texture_ms) << " ms"
+              << ", upload " << int(load_stats.upload_ms) << " ms)" << std::endl;
+
+    const auto texture_stats = texture_registry().stats();
+    std::cout << "Textures: " << texture_stats.unique << " unique of " << texture_stats.requested << " requested"
+              << " in " << texture_arrays().numArrays() << " arrays, "
+              << texture_stats.bytes / 1024 << " KB of texture data in "
+              << texture_arrays().residentBytes() / 1024 << " KB of array storage" << std::endl;
+
+    Simulation simulation(model_factory);
+
+    std::cout << "Rendering impostors... ";
+    ImpostorAtlas impostors(shader_programs[ShaderType::CLASSIC], classic_uniforms, {
+        model_factory.get_asset(ModelName::MYST_ASTEROID).get(),
+        model_factory.get_asset(ModelName::ASTEROID1).get(),
+    });
     std::cout << "\x1b[32mDone\x1b[0m" << std::endl;
 
-    int score = 0;
-    float main_ship_hp = 100.0;
-    auto main_ship = model_factory.get_model(ModelName::E45_AIRCRAFT);
-
-    std::list<Model> enemies;
-
-    std::list<Asteroid> asteroids;
-
     Font font("models/arial.ttf");
+    CounterText health_text(font, "Health: ", {5.0f, 5.0f}, {1.0f, 0.0f, 0.0f});
+    CounterText score_text(font, "Score: ", {5.0f, 45.0f}, {1.0f, 0.5f, 0.0f});
+
+    TextLayout game_over_text(font, {WIDTH / 2.0f - 100.0f, HEIGHT / 2.0f + 40.f}, {1.0f, 1.0f, 1.0f});
+    game_over_text.setText("Game Over");
+    TextLayout leave_text(font, {WIDTH / 2.0f - 140.0f, HEIGHT / 2.0f - 40.f}, {1.0f, 1.0f, 1.0f}, 0.75f);
+    leave_text.setText("Press ESC to leave");
 
-    glfwSwapInterval(1); // force 60 frames per second
+    TextBatch stats_text(font, stream_buffer);
 
-    glm::vec3 smooth_step(0.0f);
-    glm::vec3 enemies_speed(0.0f, 0.0f, 0.5f);
-    glm::vec3 particles_state(0.0f, 0.0f, 0.0f);
-    float speed_multiplier = 1.0f;
+    // The simulation runs at its own fixed rate, vsync only paces drawing
+    glfwSwapInterval(1);
 
-    glm::vec3 laser_dst;
+    gl_state().setEnabled(GL_MULTISAMPLE, true);
+    gl_state().setEnabled(GL_DEPTH_TEST, true);
+    gl_state().setEnabled(GL_BLEND, true);
+    gl_state().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl_state().setEnabled(GL_PROGRAM_POINT_SIZE, true);
 
-    const glm::vec4 view_port(0.0f, 0.0f, WIDTH, HEIGHT);
-    glEnable(GL_MULTISAMPLE);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    double previous_time = glfwGetTime();
+    double accumulator = 0.0;
     // Game loop
     while (!glfwWindowShouldClose(window)) {
         // Tech stuff
@@ -311,450 +493,288 @@ int main(int argc, char **argv) {
 
         // Game logic
 
-        // Modify environment
         const auto time = glfwGetTime();
+        // Long stalls (window drag, debugger) are dropped instead of being simulated in one burst
+        const auto frame_time = std::min(time - previous_time, 0.25);
+        accumulator += frame_time;
+        previous_time = time;
 
-        smooth_step += 0.05f * (step - smooth_step);
-        const auto camera_shift = multiplier * smooth_step;
         camera.mode = camera_mode;
         camera.rot = glm::quat({yaw, pitch, 0.0f});
-        camera.move(camera_shift);
-
-        const auto view_transform = camera.getViewTransform();
-        const auto perspective_transform = perspective * view_transform;
 
         double xpos, ypos;
         glfwGetCursorPos(window, &xpos, &ypos);
 
-        if (main_ship.dead) {
-            shoot = false;
-        }
+        // Aim through the latest simulated camera
+        camera.position = simulation.camera_position;
 
-        // Check laser status
-        if (laser.recharge != 0) {
+        TickInput input;
+        input.step = multiplier * step;
+        input.aim = Ray::fromCursor(xpos, ypos, glm::inverse(perspective * camera.getViewTransform()), WIDTH, HEIGHT);
+        while (accumulator >= Simulation::dt) {
+            input.shoot = shoot;
             shoot = false;
-            laser.recharge--;
-            laser_dst += enemies_speed + camera_shift;
-        } else if (shoot) {
-            laser.recharge = laser_recharge_rate;
-        }
-
-        // Kill targets
-        if (shoot) {
-
-            for (auto &enemy : enemies) {
-                if (enemy.dead) continue;
-
-                const auto model = view_transform * enemy.getWorldTransform();
-                const auto bbox = enemy.bbox;
-                float min_x = INFINITY;
-                float min_y = INFINITY;
-                float max_x = -INFINITY;
-                float max_y = -INFINITY;
-
-                for (const auto pos : {glm::vec3(bbox.min.x, bbox.min.y, bbox.min.z),
-                                       glm::vec3(bbox.min.x, bbox.min.y, bbox.max.z),
-                                       glm::vec3(bbox.min.x, bbox.max.y, bbox.min.z),
-                                       glm::vec3(bbox.min.x, bbox.max.y, bbox.max.z),
-                                       glm::vec3(bbox.max.x, bbox.min.y, bbox.min.z),
-                                       glm::vec3(bbox.max.x, bbox.min.y, bbox.max.z),
-                                       glm::vec3(bbox.max.x, bbox.max.y, bbox.min.z),
-                                       glm::vec3(bbox.max.x, bbox.max.y, bbox.max.z)}) {
-
-                    const auto tmp = glm::project(pos, model, perspective, view_port);
-
-                    min_x = glm::min(min_x, tmp.x);
-                    min_y = glm::min(min_y, tmp.y);
-                    max_x = glm::max(max_x, tmp.x);
-                    max_y = glm::max(max_y, tmp.y);
-                }
 
-                if (xpos >= min_x && xpos <= max_x &&
-                    HEIGHT - ypos >= min_y && HEIGHT - ypos <= max_y) {
-
-                    laser_dst = enemy.world_pos;
-                    enemy.dead = true;
-                    shoot = false;
-                    score += enemy.damage;
-                    break;
-                }
-            }
+            simulation.tick(input);
+            accumulator -= Simulation::dt;
         }
 
-        if (shoot) {
-            for (auto& asteroid : asteroids) {
-                if (asteroid.dead) continue;
-
-                const auto model = view_transform * asteroid.getWorldTransform();
-                const auto bbox = asteroid.bbox;
-                float min_x = INFINITY;
-                float min_y = INFINITY;
-                float max_x = -INFINITY;
-                float max_y = -INFINITY;
-
-                for (const auto pos : {glm::vec3(bbox.min.x, bbox.min.y, bbox.min.z),
-                                       glm::vec3(bbox.min.x, bbox.min.y, bbox.max.z),
-                                       glm::vec3(bbox.min.x, bbox.max.y, bbox.min.z),
-                                       glm::vec3(bbox.min.x, bbox.max.y, bbox.max.z),
-                                       glm::vec3(bbox.max.x, bbox.min.y, bbox.min.z),
-                                       glm::vec3(bbox.max.x, bbox.min.y, bbox.max.z),
-                                       glm::vec3(bbox.max.x, bbox.max.y, bbox.min.z),
-                                       glm::vec3(bbox.max.x, bbox.max.y, bbox.max.z)}) {
-
-                    const auto tmp = glm::project(pos, model, perspective, view_port);
-
-                    min_x = glm::min(min_x, tmp.x);
-                    min_y = glm::min(min_y, tmp.y);
-                    max_x = glm::max(max_x, tmp.x);
-                    max_y = glm::max(max_y, tmp.y);
-                }
+        // Draw the state between the last two ticks
+        const auto alpha = float(accumulator / Simulation::dt);
+        camera.position = simulation.cameraPosition(alpha);
 
-                if (xpos >= min_x && xpos <= max_x &&
-                    HEIGHT - ypos >= min_y && HEIGHT - ypos <= max_y) {
+        // Particles move with the scenery, which flows towards the camera
+        {
+            const auto scenery_velocity = float(simulation.speed_multiplier * Simulation::tick_rate) * simulation.enemies_speed;
 
-                    laser_dst = asteroid.world_pos;
-                    asteroid.dead = true;
-                    shoot = false;
-                    score += asteroid.damage;
-                    break;
-                }
+            for (const auto& explosion : simulation.explosions) {
+                particle_system->emit({explosion.position, explosion.velocity, 15.0f, 1.5f, 2000});
             }
-        }
+            simulation.explosions.clear();
 
-        if (shoot) {
-            const auto tmp = glm::inverse(perspective_transform) * glm::vec4(2.0 * xpos / WIDTH - 1.0, -2.0 * ypos / HEIGHT + 1.0, 1.0f, 1.0f);
-            laser_dst = glm::vec3(tmp) / tmp.w;
-            shoot = false;
-        }
+            if (!simulation.main_ship.dead) {
+                const auto ship_position = simulation.shipPosition(alpha);
+                const auto nozzle = glm::vec3(ship_position.x, ship_position.y, simulation.main_ship.getBBox().max.z);
 
-        // Process enemies
-        for (auto it = enemies.begin(); it != enemies.end();) {
-            if (!it->dead) {
-                if (intersect(main_ship.getBBox(), it->getBBox())) {
-                    main_ship_hp = std::max(main_ship_hp - it->damage, 0.0f);
-                    it->dead = true;
-                } else if (it->world_pos.z > 200.0f) {
-                    enemies.erase(it++);
-                    continue;
-                }
+                trail_particles += 3000.0f * float(frame_time);
+                const auto count = uint32_t(trail_particles);
+                trail_particles -= float(count);
 
-                // Shoot
-                if (rand() % 1000 == 0) {
-                    asteroids.emplace_back(model_factory.get_model(ModelName::ROCKET, it->world_pos),
-                        speed_multiplier * 2.0f * glm::normalize(main_ship.world_pos - it->world_pos));
-                }
-            } else {
-                if (it->die()) {
-                    enemies.erase(it++);
-                    continue;
-                }
+                particle_system->emit({nozzle, scenery_velocity + glm::vec3(0.0f, 0.0f, 10.0f), 1.5f, 0.5f, count});
             }
-            it->move(speed_multiplier * enemies_speed);
-            it++;
-        }
 
-        // Process asteroids
-        for (auto it = asteroids.begin(); it != asteroids.end();){
-            if (!it->dead) {
-                if (intersect(main_ship.getBBox(), it->getBBox())) {
-                    main_ship_hp = std::max(main_ship_hp - it->damage, 0.0f);
-                    it->dead = true;
-                } else if (it->world_pos.z > 200.0f) {
-                    asteroids.erase(it++);
-                    continue;
-                }
-            } else {
-                if (it->die()) {
-                    asteroids.erase(it++);
-                    continue;
-                }
-            }
-            it->moveAuto(speed_multiplier);
-            it++;
+            particle_system->update(float(frame_time));
         }
 
-        // Enemies spawn
-        if (rand() % 300 == 0) {
-            enemies.push_back(model_factory.get_random_enemy(camera.position));
-            enemies.back().damage = 50.0f;
-        }
-
-        // Asteroids spawn
-        if (rand() % 300 == 0) {
-            asteroids.push_back(model_factory.get_random_asteroid(camera.position, main_ship.world_pos));
-            asteroids.back().damage = 25.0f;
-        }
-
-        main_ship.move(camera_shift);
-        if (main_ship_hp == 0.0f) {
-            main_ship.dead = true;
-        }
+        const auto view_transform = camera.getViewTransform();
+        const auto perspective_transform = perspective * view_transform;
 
-        particles_state += speed_multiplier * enemies_speed;
+        // Drawing: every pass submits packets, the queue sorts them and skips redundant binds
 
-        speed_multiplier += 0.0001f;
+        FrameState frame;
+        frame.view_projection = perspective_transform;
+        frame.sky_transform = perspective * glm::mat4(glm::mat3(view_transform));
+        const auto particles_state = simulation.particles_state - (1.0f - alpha) * simulation.speed_multiplier * simulation.enemies_speed;
+        frame.starfield_world = glm::translate(glm::mat4(1.0f), particles_state - camera.position);
+        frame.starfield_projection = frame.sky_transform;
+        frame.starfield_velocity = simulation.enemies_speed - simulation.camera_shift;
+        frame.crosshair_position = glm::vec2(2.0 * xpos / WIDTH - 1.0, -2.0 * ypos / HEIGHT + 1.0);
+        frame.hud_transform = glm::ortho(0.0f, float(WIDTH), 0.0f, float(HEIGHT));
 
-        // Drawing
+        const auto eye = glm::vec3(glm::inverse(view_transform)[3]);
+        frame.eye = eye;
 
-        // Draw skybox
+        // Skybox
         {
-            auto& program = shader_programs[ShaderType::SKYBOX];
-
-            glDepthMask(GL_FALSE);
-            program.StartUseShader();
-
-            const auto transform = perspective * glm::mat4(glm::mat3(view_transform));
-            program.SetUniform("transform", transform);
-
-            skybox.draw();
-
-            program.StopUseShader();
-            glDepthMask(GL_TRUE);
+            const auto& program = shader_programs[ShaderType::SKYBOX];
+            render_queue.setFrameUniforms(program, set_sky_uniforms, &frame);
+            render_queue.submitDraw(RenderPass::SKY, program, skybox);
         }
 
-        // Draw particles
+        // Starfield
         {
-            auto& program = shader_programs[ShaderType::PARTICLES];
-
-            program.StartUseShader();
-
-            program.SetUniform("world_transform", glm::translate(glm::mat4(1.0f), particles_state - camera.position));
-            program.SetUniform("perspective_transform", perspective * glm::mat4(glm::mat3(view_transform)));
-
-            program.SetUniform("velocity", enemies_speed - camera_shift);
-
-            particles.draw();
-
-            program.StopUseShader();
+            const auto& program = shader_programs[ShaderType::PARTICLES];
+            render_queue.setFrameUniforms(program, set_starfield_uniforms, &frame);
+            render_queue.submitDraw(RenderPass::STARFIELD, program, particles);
         }
 
-        // Draw objects
+        // Culling: entities outside the view frustum are left out of both mesh passes.
+        // The rest get a level of detail by their size on screen
         {
-            auto& program = shader_programs[ShaderType::CLASSIC];
-            program.StartUseShader();
-            GL_CHECK_ERRORS;
-
-            // Draw enemies
-            for (const auto &model : enemies) {
-                if (model.dead) continue;
-                const auto local = perspective_transform * model.getWorldTransform();
-                for (const auto &object : model.objects) {
-                    const auto transform = local * object.getWorldTransform();
-                    program.SetUniform("transform", transform);
-
-                    const auto color = object.getDiffuseColor();
-                    program.SetUniform("diffuse_color", color);
-
-                    const bool use_texture = object.haveTexture();
-                    program.SetUniform("use_texture", use_texture);
-
-                    const float opacity = object.getOpacity();
-                    program.SetUniform("opacity", opacity);
-
-                    object.draw();
-                    GL_CHECK_ERRORS;
-                }
+            auto& entities = simulation.entities;
+            entity_culler.clear();
+            entity_transforms.clear();
+            for (size_t i = 0; i < entities.size(); i++) {
+                entity_transforms.push_back(entities.worldTransform(i, entities.position(i, alpha)));
+                const auto bbox = entities.asset[i]->bbox.transformed(entity_transforms.back());
+                entity_culler.add(bbox);
+                entities.lod[i] = uint8_t(entities.asset[i]->selectLod(projected_size(bbox, eye, focal_length), entities.lod[i]));
             }
-
-            // Draw asteroids
-            for (const auto &model : asteroids) {
-                if (model.dead) continue;
-                const auto local = perspective_transform * model.getWorldTransform();
-                for (const auto &object : model.objects) {
-                    const auto transform = local * object.getWorldTransform();
-                    program.SetUniform("transform", transform);
-
-                    const auto color = object.getDiffuseColor();
-                    program.SetUniform("diffuse_color", color);
-
-                    const bool use_texture = object.haveTexture();
-                    program.SetUniform("use_texture", use_texture);
-
-                    const float opacity = object.getOpacity();
-                    program.SetUniform("opacity", opacity);
-
-                    object.draw();
-                    GL_CHECK_ERRORS;
-                }
-            }
-
-            program.StopUseShader();
+            entity_culler.cull(camera.getFrustum(perspective));
         }
 
-        // Draw dead objects
+        // Objects. Past impostor_distance asteroids fade from their mesh into an impostor
         {
-            auto& program = shader_programs[ShaderType::EXPLOSION];
+            const auto fade_distance = 0.2f * impostor_distance;
 
-            program.StartUseShader();
+            const auto& entities = simulation.entities;
+            for (size_t i = 0; i < entities.size(); i++) {
+                if (entities.dying[i] || !entity_culler.visible(i)) continue;
 
-            // Draw enemies
-            for (const auto &model : enemies) {
-                if (!model.dead) continue;
-                const auto local = perspective_transform * model.getWorldTransform();
-                const auto death_coef = float(model.death_countdown) / 60;
-                program.SetUniform("magnitude", (1.0f - death_coef) * 5.0f);
-                for (const auto &object : model.objects) {
-                    const auto transform = local * object.getWorldTransform();
-                    program.SetUniform("transform", transform);
-
-                    const auto color = object.getDiffuseColor();
-                    program.SetUniform("diffuse_color", color);
-
-                    const bool use_texture = object.haveTexture();
-                    program.SetUniform("use_texture", use_texture);
-
-                    const float opacity = death_coef * object.getOpacity();
-                    program.SetUniform("opacity", opacity);
-
-                    object.draw();
-                    GL_CHECK_ERRORS;
+                const auto asset = entities.asset[i];
+                auto fade = 0.0f;
+                if (impostor_distance > 0.0f && impostors.has(asset)) {
+                    const auto distance = glm::length(glm::vec3(entity_transforms[i][3]) - eye);
+                    fade = glm::clamp((distance - impostor_distance) / fade_distance, 0.0f, 1.0f);
                 }
-            }
 
-            // Draw asteroids
-            for (const auto &model : asteroids) {
-                if (!model.dead) continue;
-                const auto local = perspective_transform * model.getWorldTransform();
-                const auto death_coef = float(model.death_countdown) / 60;
-                program.SetUniform("magnitude", (1.0f - death_coef) * 5.0f);
-                for (const auto &object : model.objects) {
-                    const auto transform = local * object.getWorldTransform();
-                    program.SetUniform("transform", transform);
-
-                    const auto color = object.getDiffuseColor();
-                    program.SetUniform("diffuse_color", color);
-
-                    const bool use_texture = object.haveTexture();
-                    program.SetUniform("use_texture", use_texture);
-
-                    const float opacity = death_coef * object.getOpacity();
-                    program.SetUniform("opacity", opacity);
-
-                    object.draw();
-                    GL_CHECK_ERRORS;
+                if (fade < 1.0f) {
+                    mesh_renderer.add(asset, entity_transforms[i], 1.0f - fade, 0.0f, entities.lod[i]);
+                }
+                if (fade > 0.0f) {
+                    impostors.add(asset, entity_transforms[i], entities.scale[i], eye, fade);
                 }
             }
+            if (!simulation.main_ship.dead) {
+                mesh_renderer.add(simulation.main_ship.asset.get(), simulation.shipTransform(alpha));
+            }
 
-            program.StopUseShader();
+            const auto& program = shader_programs[ShaderType::CLASSIC];
+            render_queue.setFrameUniforms(program, set_mesh_uniforms, &frame);
+            mesh_renderer.submit(render_queue, RenderPass::MESHES, program, classic_uniforms, eye);
         }
 
-        // Draw laser
-        if (laser.recharge != 0) {
-            auto& program = shader_programs[ShaderType::LASER];
-
-            program.StartUseShader();
-
-            program.SetUniform("transform", perspective_transform);
-
-            glLineWidth(5.0f * float(laser.recharge) / laser_recharge_rate);
-            laser.draw(main_ship.world_pos, laser_dst);
-            glLineWidth(1.0f);
-
-            program.StopUseShader();
+        // Impostors
+        {
+            const auto& program = shader_programs[ShaderType::IMPOSTOR];
+            render_queue.setFrameUniforms(program, set_impostor_uniforms, &frame);
+            render_queue.submitDraw(RenderPass::IMPOSTORS, program, impostors);
         }
 
-        // Main ship
-        if (!main_ship.dead) {
-            auto& program = shader_programs[ShaderType::CLASSIC];
-            program.StartUseShader();
-
-            const auto local = perspective_transform * main_ship.getWorldTransform();
-            for (const auto &object : main_ship.objects) {
-                const auto transform = local * object.getWorldTransform();
-                program.SetUniform("transform", transform);
-
-                const auto color = object.getDiffuseColor();
-                program.SetUniform("diffuse_color", color);
-
-                const bool use_texture = object.haveTexture();
-                program.SetUniform("use_texture", use_texture);
-
-                const float opacity = object.getOpacity();
-                program.SetUniform("opacity", opacity);
-
-                object.draw();
-                GL_CHECK_ERRORS;
+        // Dead objects
+        {
+            const auto add_dead = [&explosion_renderer](const MeshAsset* asset, const glm::mat4& transform, int death_countdown, int lod) {
+                const auto death_coef = float(death_countdown) / Simulation::death_frames;
+                explosion_renderer.add(asset, transform, death_coef, (1.0f - death_coef) * 5.0f, lod);
+            };
+
+            const auto& entities = simulation.entities;
+            for (size_t i = 0; i < entities.size(); i++) {
+                if (entities.dying[i] && entity_culler.visible(i)) {
+                    add_dead(entities.asset[i], entity_transforms[i], entities.death_countdown[i], entities.lod[i]);
+                }
             }
-            program.StopUseShader();
-
-        } else if (!main_ship.die()) {
-            auto& program = shader_programs[ShaderType::EXPLOSION];
-            program.StartUseShader();
-
-            const auto local = perspective_transform * main_ship.getWorldTransform();
-            const auto death_coef = float(main_ship.death_countdown) / 60;
-            program.SetUniform("magnitude", (1.0f - death_coef) * 5.0f);
-            for (const auto &object : main_ship.objects) {
-                const auto transform = local * object.getWorldTransform();
-                program.SetUniform("transform", transform);
-
-                const auto color = object.getDiffuseColor();
-                program.SetUniform("diffuse_color", color);
-
-                const bool use_texture = object.haveTexture();
-                program.SetUniform("use_texture", use_texture);
-
-                const float opacity = death_coef * object.getOpacity();
-                program.SetUniform("opacity", opacity);
-
-                object.draw();
-                GL_CHECK_ERRORS;
+            const auto& main_ship = simulation.main_ship;
+            if (main_ship.dead && main_ship.death_countdown > 0) {
+                add_dead(main_ship.asset.get(), simulation.shipTransform(alpha), main_ship.death_countdown, 0);
             }
 
-            program.StopUseShader();
+            const auto& program = shader_programs[ShaderType::EXPLOSION];
+            render_queue.setFrameUniforms(program, set_mesh_uniforms, &frame);
+            explosion_renderer.submit(render_queue, RenderPass::EXPLOSIONS, program, explosion_uniforms, eye);
         }
 
-        // Draw crosshair
+        // Engine trails and explosions
         {
-            auto& program = shader_programs[ShaderType::CROSSHAIR];
-
-            program.StartUseShader();
-
-            program.SetUniform("position", glm::vec2(2.0 * xpos / WIDTH - 1.0, -2.0 * ypos / HEIGHT + 1.0));
-
-            crosshair.draw();
+            const auto& program = shader_programs[ShaderType::PARTICLE_RENDER];
+            render_queue.setFrameUniforms(program, set_particle_uniforms, &frame);
+            render_queue.submitDraw(RenderPass::PARTICLES, program, *particle_system);
+        }
 
-            program.StopUseShader();
+        // Laser
+        LaserDraw laser_draw {laser, simulation.shipPosition(alpha), simulation.laser_dst,
+                              5.0f * float(simulation.laser_recharge) / Simulation::laser_recharge_rate};
+        if (simulation.laser_recharge != 0) {
+            const auto& program = shader_programs[ShaderType::LASER];
+            render_queue.setFrameUniforms(program, set_laser_uniforms, &frame);
+            render_queue.submitDraw(RenderPass::EFFECTS, program, laser_draw);
         }
 
-        // Draw text
+        // Crosshair
         {
-            auto& program = shader_programs[ShaderType::TEXT];
-
-            program.StartUseShader();
+            const auto& program = shader_programs[ShaderType::CROSSHAIR];
+            render_queue.setFrameUniforms(program, set_crosshair_uniforms, &frame);
+            render_queue.submitDraw(RenderPass::HUD, program, crosshair);
+        }
 
-            const auto transform = glm::ortho(0.0f, float(WIDTH), 0.0f, float(HEIGHT));
+        // Text
+        {
+            const auto& program = shader_programs[ShaderType::TEXT];
+            render_queue.setFrameUniforms(program, set_text_uniforms, &frame);
 
             // Health Points
-            program.SetUniform("transform", glm::translate(transform, {5.0f, 5.0f, 0.0f}));
-            program.SetUniform("text_color", glm::vec3(1.0f, 0.0f, 0.0f));
-            font.draw("Health: " + std::to_string(int(main_ship_hp)));
+            health_text.setValue(int(simulation.main_ship_hp));
+            render_queue.submitDraw(RenderPass::HUD, program, health_text);
 
             // Score
-            program.SetUniform("transform", glm::translate(transform, {5.0f, 45.0f, 0.0f}));
-            program.SetUniform("text_color", glm::vec3(1.0f, 0.5f, 0.0f));
-            font.draw("Score: " + std::to_string(score));
+            score_text.setValue(simulation.score);
+            render_queue.submitDraw(RenderPass::HUD, program, score_text);
 
             // Game Over
-            if (main_ship.dead) {
-                program.SetUniform("transform", glm::translate(transform, {WIDTH / 2.0f - 100.0f, HEIGHT / 2.0f + 40.f, 0.0f}));
-                program.SetUniform("text_color", glm::vec3(1.0f, 1.0f, 1.0f));
-                font.draw("Game Over");
-
-                program.SetUniform("transform", glm::scale(glm::translate(transform, {WIDTH / 2.0f - 140.0f, HEIGHT / 2.0f - 40.f, 0.0f}), {0.75f, 0.75f, 0.75f}));
-                program.SetUniform("text_color", glm::vec3(1.0f, 1.0f, 1.0f));
-                font.draw("Press ESC to leave");
+            if (simulation.main_ship.dead) {
+                render_queue.submitDraw(RenderPass::HUD, program, game_over_text);
+                render_queue.submitDraw(RenderPass::HUD, program, leave_text);
             }
 
-            program.StopUseShader();
-            GL_CHECK_ERRORS;
+            // State changes of the previous frame
+            if (show_render_stats) {
+                const auto& stats = render_queue.lastFrameStats();
+                stats_text.add("Packets " + std::to_string(stats.packets)
+                               + "  programs " + std::to_string(stats.program_switches)
+                               + "  textures " + std::to_string(stats.texture_binds)
+                               + "  VAOs " + std::to_string(stats.vertex_array_binds)
+                               + "  skipped " + std::to_string(stats.skipped_binds),
+                               {5.0f, HEIGHT - 30.0f}, {0.6f, 1.0f, 0.6f}, 0.5f);
+                const auto& gl_stats = gl_state().lastFrameStats();
+                stats_text.add("GL state calls " + std::to_string(gl_stats.calls)
+                               + "  skipped " + std::to_string(gl_stats.skipped),
+                               {5.0f, HEIGHT - 50.0f}, {0.6f, 1.0f, 0.6f}, 0.5f);
+                const auto& cull_stats = entity_culler.lastStats();
+                stats_text.add("Entities visible " + std::to_string(cull_stats.tested - cull_stats.culled)
+                               + "  culled " + std::to_string(cull_stats.culled)
+                               + "  impostors " + std::to_string(impostors.size()),
+                               {5.0f, HEIGHT - 70.0f}, {0.6f, 1.0f, 0.6f}, 0.5f);
+                const auto& lod_stats = mesh_renderer.lodStats();
+                std::string lod_line = "LOD instances/triangles";
+                for (int lod = 0; lod < MeshData::max_lods; lod++) {
+                    lod_line += "  " + std::to_string(lod_stats.instances[lod]) + "/" + std::to_string(lod_stats.triangles[lod]);
+                }
+                stats_text.add(lod_line, {5.0f, HEIGHT - 90.0f}, {0.6f, 1.0f, 0.6f}, 0.5f);
+                render_queue.submitDraw(RenderPass::HUD, program, stats_text);
+            }
         }
 
+        render_queue.execute();
+        GL_CHECK_ERRORS;
+
+        mesh_renderer.clear();
+        impostors.clear();
+        explosion_renderer.clear();
+
+        stream_buffer.endFrame();
+        gl_state().endFrame();
         glfwSwapBuffers(window);
 
     }
     std::cout << "\nGame Over!" << std::endl;
 
+    if (simulation.tick_seconds > 0.0) {
+        std::cout << "Simulated " << simulation.ticks << " ticks: "
+                  << int(simulation.ticks / simulation.tick_seconds) << " ticks/s" << std::endl;
+    }
+
+    std::cout << "Streamed " << int(stream_buffer.averageBytesPerFrame()) << " bytes per frame" << std::endl;
+
+    const auto frames = render_queue.numFrames();
+    if (frames != 0) {
+        const auto& stats = render_queue.totalStats();
+        std::cout << "Per frame: " << stats.packets / frames << " draw packets, "
+                  << stats.program_switches / frames << " program switches, "
+                  << stats.texture_binds / frames << " texture binds, "
+                  << stats.vertex_array_binds / frames << " VAO binds, "
+                  << stats.skipped_binds / frames << " binds skipped" << std::endl;
+    }
+
+    const auto cull_frames = entity_culler.numFrames();
+    if (cull_frames != 0) {
+        const auto& stats = entity_culler.totalStats();
+        std::cout << "Per frame: " << stats.tested / cull_frames << " entities tested, "
+                  << stats.culled / cull_frames << " culled" << std::endl;
+    }
+
+    if (check_particles) {
+        std::cout << "Particle update error against the CPU reference: " << gpu_particles->referenceError()
+                  << " worst over " << gpu_particles->numReferenceChecks() << " checks" << std::endl;
+    }
+
+    const auto spawn_count = simulation.spawn_count;
+    if (spawn_count != 0) {
+        std::cout << "Spawned " << spawn_count << " models: "
+                  << simulation.spawn_allocs.allocations / spawn_count << " allocations, "
+                  << simulation.spawn_allocs.bytes / spawn_count << " bytes per spawn" << std::endl;
+    }
+
+    texture_registry().detachContext();
     glfwTerminate();
     return 0;
 }
@@ -1,13 +1,19 @@
 #version 330
 
-layout(location = 0) in vec3 vertex;
+layout(location = 0) in vec3 vertex; // fraction of the part's bounds
 layout(location = 1) in vec2 texture_coordinates;
+layout(location = 2) in mat4 instance_transform;
+layout(location = 6) in vec2 instance_params; // opacity, explosion magnitude
 
-uniform mat4 transform;
+uniform mat4 view_projection;
+uniform vec3 position_offset;
+uniform vec3 position_scale;
 
 out vec2 texture_coords;
+out float instance_opacity;
 
 void main() {
-    gl_Position  = transform * vec4(vertex, 1.0f);
+    gl_Position  = view_projection * instance_transform * vec4(position_offset + position_scale * vertex, 1.0f);
     texture_coords = texture_coordinates;
+    instance_opacity = instance_params.x;
 }
@@ -1,19 +1,21 @@
 #version 330 core
 
 in vec2 tex_coords;
+in float instance_opacity;
 
 out vec4 color;
 
 uniform vec4 diffuse_color;
-uniform sampler2D Texture;
+uniform sampler2DArray Texture;
 uniform int use_texture;
+uniform float texture_layer;
 uniform float opacity;
 
 void main() {
     if (use_texture != 0) {
-        color = texture(Texture, tex_coords);
+        color = texture(Texture, vec3(tex_coords, texture_layer));
     } else {
         color = diffuse_color;
     }
-    color.a = opacity;
+    color.a = opacity * instance_opacity;
 }
\ No newline at end of file
@@ -5,26 +5,31 @@ layout (triangle_strip, max_vertices = 3) out;
 
 in vec4 point_positions[];
 in vec2 texture_coords[];
+in vec2 point_params[];
 
 out vec2 tex_coords;
-
-uniform float magnitude;
+out float instance_opacity;
 
 void main() {
+    float magnitude = point_params[0].y;
+
     vec3 a = vec3(point_positions[0] - point_positions[1]);
     vec3 b = vec3(point_positions[1] - point_positions[2]);
     vec3 norm = normalize(cross(a, b));
 
     gl_Position = point_positions[0] + vec4(norm * magnitude, 0.0f);
     tex_coords = texture_coords[0];
+    instance_opacity = point_params[0].x;
     EmitVertex();
 
     gl_Position = point_positions[1] + vec4(norm * magnitude, 0.0f);
     tex_coords = texture_coords[1];
+    instance_opacity = point_params[0].x;
     EmitVertex();
 
     gl_Position = point_positions[2] + vec4(norm * magnitude, 0.0f);
     tex_coords = texture_coords[2];
+    instance_opacity = point_params[0].x;
     EmitVertex();
 
     EndPrimitive();
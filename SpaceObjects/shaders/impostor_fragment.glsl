@@ -0,0 +1,16 @@
+#version 330 core
+
+in vec2 texture_coords;
+in float opacity;
+
+out vec4 color;
+
+uniform sampler2D Texture; // premultiplied
+
+void main() {
+    vec4 texel = texture(Texture, texture_coords);
+    if (texel.a < 0.5) {
+        discard;
+    }
+    color = vec4(texel.rgb / texel.a, opacity);
+}
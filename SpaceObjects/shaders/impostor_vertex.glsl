@@ -0,0 +1,31 @@
+#version 330
+
+layout (location = 0) in vec4 center_radius;
+layout (location = 1) in vec4 up_opacity;
+layout (location = 2) in vec4 cell; // origin and size in the atlas
+
+uniform mat4 view_projection;
+uniform vec3 eye;
+
+out vec2 texture_coords;
+out float opacity;
+
+const vec2 corners[4] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, 1.0));
+
+void main() {
+    vec2 corner = corners[gl_VertexID];
+    vec3 center = center_radius.xyz;
+    float radius = center_radius.w;
+
+    // Turned to face the eye around the up axis of the picture
+    vec3 to_eye = normalize(eye - center);
+    vec3 right = normalize(cross(up_opacity.xyz, to_eye));
+    vec3 up = cross(to_eye, right);
+
+    // At the front of the bounding sphere, so the mesh fading out behind does not cut through it
+    vec3 position = center + radius * (to_eye + corner.x * right + corner.y * up);
+    gl_Position = view_projection * vec4(position, 1.0);
+
+    texture_coords = cell.xy + (0.5 * corner + 0.5) * cell.zw;
+    opacity = up_opacity.w;
+}
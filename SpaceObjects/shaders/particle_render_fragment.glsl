@@ -0,0 +1,13 @@
+#version 330
+
+in vec4 color;
+
+out vec4 frag_color;
+
+void main() {
+    // Round points fading towards the edge
+    float falloff = 1.0 - 2.0 * length(gl_PointCoord - vec2(0.5));
+    if (falloff <= 0.0) discard;
+
+    frag_color = vec4(color.rgb, color.a * falloff);
+}
@@ -0,0 +1,26 @@
+#version 330
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in float age;
+layout (location = 3) in float lifetime;
+
+uniform mat4 view_projection;
+uniform float point_scale; // point size in pixels of a unit sized particle at unit distance
+
+out vec4 color;
+
+void main() {
+    if (age >= lifetime) {
+        // Dead slot, clipped away
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        gl_PointSize = 0.0;
+        color = vec4(0.0);
+        return;
+    }
+
+    float t = age / lifetime;
+    color = mix(vec4(1.0, 0.9, 0.6, 1.0), vec4(0.8, 0.2, 0.05, 0.0), t);
+
+    gl_Position = view_projection * vec4(position, 1.0);
+    gl_PointSize = max(point_scale * (1.0 - 0.5 * t) / gl_Position.w, 1.0);
+}
@@ -0,0 +1,84 @@
+#version 330
+
+// Keep in sync with update_particles_reference() in ParticleSystem.cpp
+
+#define MAX_EMISSIONS 16
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in float age;
+layout (location = 2) in vec3 velocity;
+layout (location = 3) in float lifetime;
+
+out vec3 out_position;
+out float out_age;
+out vec3 out_velocity;
+out float out_lifetime;
+
+uniform float dt;
+uniform float drag;
+uniform uint frame;
+uniform uint capacity;
+
+uniform int num_emissions;
+uniform uint emission_start[MAX_EMISSIONS];
+uniform uint emission_count[MAX_EMISSIONS];
+uniform vec3 emission_position[MAX_EMISSIONS];
+uniform vec3 emission_velocity[MAX_EMISSIONS];
+uniform float emission_spread[MAX_EMISSIONS];
+uniform float emission_lifetime[MAX_EMISSIONS];
+
+uint hash(uint x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float next_random(inout uint state) {
+    state = hash(state);
+    return float(state >> 8) * (1.0 / 16777216.0);
+}
+
+void spawn(uint id, int e) {
+    uint state = hash(id ^ hash(frame));
+
+    float x = 2.0 * next_random(state) - 1.0;
+    float y = 2.0 * next_random(state) - 1.0;
+    float z = 2.0 * next_random(state) - 1.0;
+    float speed = emission_spread[e] * next_random(state);
+    float life = 0.5 + 0.5 * next_random(state);
+
+    vec3 direction = vec3(x, y, z);
+    float len = length(direction);
+    direction = len > 1e-6 ? direction / len : vec3(0.0);
+
+    out_position = emission_position[e];
+    out_age = 0.0;
+    out_velocity = emission_velocity[e] + speed * direction;
+    out_lifetime = emission_lifetime[e] * life;
+}
+
+void main() {
+    uint id = uint(gl_VertexID);
+
+    out_position = position;
+    out_age = age;
+    out_velocity = velocity;
+    out_lifetime = lifetime;
+
+    bool spawned = false;
+    for (int e = 0; e < num_emissions; e++) {
+        if ((id + capacity - emission_start[e]) % capacity < emission_count[e]) {
+            spawn(id, e);
+            spawned = true;
+        }
+    }
+
+    if (!spawned && age < lifetime) {
+        out_position = position + velocity * dt;
+        out_velocity = velocity * max(1.0 - drag * dt, 0.0);
+        out_age = age + dt;
+    }
+}
@@ -1,10 +1,10 @@
 #version 330
 
 in vec2 tex_coords;
+in vec3 text_color;
 out vec4 color;
 
 uniform sampler2D Texture;
-uniform vec3 text_color;
 
 void main() {
     color = vec4(text_color, texture(Texture, tex_coords).r);
@@ -1,12 +1,15 @@
 #version 330
 
 layout (location = 0) in vec4 vertex;
+layout (location = 1) in vec3 color;
 
 out vec2 tex_coords;
+out vec3 text_color;
 
 uniform mat4 transform;
 
 void main() {
     gl_Position = transform * vec4(vertex.xy, 0.0, 1.0);
     tex_coords = vertex.zw;
+    text_color = color;
 }